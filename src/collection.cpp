@@ -1,17 +1,37 @@
 #include "collection.h"
 
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+
 #include "taskmanager.h"
+#include "trace.h"
+#include "ioring.h"
 
 namespace fs = std::filesystem;
 
 static const std::string flac(".flac");
 
-Collection::Collection(const std::filesystem::path& path, const std::shared_ptr<TaskManager>& tm, const std::shared_ptr<Settings>& st):
+Collection::Collection(
+    const std::filesystem::path& path,
+    const std::shared_ptr<TaskManager>& tm,
+    const std::shared_ptr<Settings>& st,
+    const std::shared_ptr<Printer>& lg
+):
     path(path),
     countMusical(0),
     counted(false),
     taskManager(tm),
-    settings(st)
+    settings(st),
+    logger(lg),
+    scanners(),
+    pendingDirectories(0),
+    queuedDirectories(0),
+    idleMutex(),
+    idleConditional()
 {}
 
 Collection::~Collection()
@@ -60,32 +80,176 @@ void Collection::convert(const std::string& outPath) {
     fs::path out = fs::absolute(outPath);
 
     fs::create_directories(out);
-    out = fs::canonical(outPath);
-    for (const fs::directory_entry& entry : fs::directory_iterator(path)) {
-        fs::path sourcePath = entry.path();
+    out = fs::canonical(outPath);   //the only time, every nested path is built from this one
+
+    unsigned int amount = settings->getScanThreads();
+    scanners.clear();
+    for (unsigned int i = 0; i < amount; ++i)
+        scanners.emplace_back(std::make_unique<Scanner>());
+
+    pushDirectory(0, std::make_shared<const Directory>(path, out));
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < amount; ++i)
+        threads.emplace_back(&Collection::scan, this, i);
+
+    scan(0);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    scanners.clear();
+}
+
+void Collection::scan(unsigned int index) {
+    Trace::nameThread("scanner " + std::to_string(index));
+    std::shared_ptr<const Directory> directory;
+    while (true) {
+        if (takeDirectory(index, directory)) {
+            scanDirectory(index, directory);
+            if (--pendingDirectories == 0) {
+                std::lock_guard lock(idleMutex);    //so that no one misses the notification
+                idleConditional.notify_all();
+            }
+            continue;
+        }
+
+        Trace::Span span("wait", "idle");
+        std::unique_lock lock(idleMutex);
+        while (queuedDirectories == 0 && pendingDirectories != 0)
+            idleConditional.wait(lock);
+
+        if (pendingDirectories == 0)
+            return;
+    }
+}
+
+void Collection::scanDirectory(unsigned int index, const std::shared_ptr<const Directory>& directory) {
+    fs::path source = directory->source();
+    fs::path destination = directory->destination();
+    Trace::Span span("scan", source.native());
+    std::error_code ec;
+    IORing* ring = IORing::forThread();
+    bool creating = ring != nullptr && ring->mkdir(destination.c_str(), 0777, 0);
+    if (creating)
+        ring->submit();     //the destination is being made while the source is opened, both might be on the network
+    else
+        fs::create_directory(destination, ec);
+
+    DIR* stream = opendir(source.c_str());
+    int error = errno;
+    if (creating) {
+        std::optional<IORing::Completion> made = ring->wait();
+        int result = made.has_value() ? made->result : -EIO;
+        if (result == -EEXIST && fs::is_directory(destination, ec))
+            result = 0;
+        if (IORing::isUnsupported(result))
+            fs::create_directory(destination, ec);      //the filesystem can't do it through the ring
+        else if (result < 0)
+            ec = std::error_code(-result, std::generic_category());
+    }
+
+    if (ec) {
+        if (stream != nullptr)
+            closedir(stream);
+
+        report("Couldn't create directory " + destination.string() + ": " + ec.message());
+        return;
+    }
+
+    if (stream == nullptr) {
+        report("Couldn't read directory " + source.string() + ": " + strerror(error));
+        return;
+    }
+
+    int descriptor = dirfd(stream);
+    while (struct dirent* entry = readdir(stream)) {
+        const char* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+
+        fs::path sourcePath = source / name;
         if (settings->isExcluded(sourcePath))
             continue;
 
-        switch (entry.status().type()) {
-            case fs::file_type::regular: {
+        struct stat info;
+        unsigned char type = entry->d_type;
+        if (type != DT_DIR) {   //regular files need stat for the manifest anyway, the rest is resolved the same way
+            if (fstatat(descriptor, name, &info, 0) != 0)
+                continue;
+
+            if (S_ISREG(info.st_mode))
+                type = DT_REG;
+            else if (S_ISDIR(info.st_mode))
+                type = DT_DIR;
+            else
+                continue;
+        }
+
+        switch (type) {
+            case DT_REG: {
+                Manifest::Entry described;
+                Manifest::describe(sourcePath, info, described);
                 if (isMusic(sourcePath))
-                    taskManager->queueConvert(sourcePath, out / sourcePath.stem());
+                    taskManager->queueConvert(directory, name, described);
                 else
-                    taskManager->queueCopy(sourcePath, out / sourcePath.filename());
-            }   break;
-            case fs::file_type::directory: {
-                Collection collection(sourcePath, taskManager, settings);
-                fs::path::iterator itr = sourcePath.end();
-                --itr;
-                collection.convert(std::string(out / *itr));
+                    taskManager->queueCopy(directory, name, described);
             }   break;
+            case DT_DIR:
+                pushDirectory(index, std::make_shared<const Directory>(directory, name));
+                break;
             default:
                 break;
         }
     }
+
+    closedir(stream);
+}
+
+void Collection::pushDirectory(unsigned int index, std::shared_ptr<const Directory>&& directory) {
+    ++pendingDirectories;
+    ++queuedDirectories;        //before it's visible to the thieves, so that the counter never goes below zero
+    Scanner& scanner = *scanners[index];
+    std::unique_lock lock(scanner.mutex);
+    scanner.directories.push_back(std::move(directory));
+    lock.unlock();
+
+    std::lock_guard idleLock(idleMutex);
+    idleConditional.notify_one();
+}
+
+bool Collection::takeDirectory(unsigned int index, std::shared_ptr<const Directory>& directory) {
+    {   //own directories go depth first, it keeps the queue short and the disk heads close
+        Scanner& own = *scanners[index];
+        std::lock_guard lock(own.mutex);
+        if (!own.directories.empty()) {
+            directory = std::move(own.directories.back());
+            own.directories.pop_back();
+            --queuedDirectories;
+            return true;
+        }
+    }
+
+    for (std::size_t i = 1; i < scanners.size(); ++i) {     //stealing goes breadth first, it takes the biggest chunks
+        Scanner& victim = *scanners[(index + i) % scanners.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.directories.empty()) {
+            directory = std::move(victim.directories.front());
+            victim.directories.pop_front();
+            --queuedDirectories;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Collection::report(const std::string& message) const {
+    if (logger)
+        logger->error(message);
+    else
+        std::cout << message << std::endl;
 }
 
 bool Collection::isMusic(const std::filesystem::path& path) {
     return path.extension() == flac;    //I know, it's primitive yet, but it's the fastest
 }
-
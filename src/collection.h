@@ -4,15 +4,27 @@
 #include <iostream>
 #include <filesystem>
 #include <memory>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 #include "settings.h"
 #include "flactomp3.h"
+#include "directory.h"
+#include "logger/printer.h"
 
 class TaskManager;
 
 class Collection {
 public:
-    Collection(const std::filesystem::path& path, const std::shared_ptr<TaskManager>& tm, const std::shared_ptr<Settings>& st);
+    Collection(
+        const std::filesystem::path& path,
+        const std::shared_ptr<TaskManager>& tm,
+        const std::shared_ptr<Settings>& st,
+        const std::shared_ptr<Printer>& lg = nullptr
+    );
     ~Collection();
 
     void list() const;
@@ -20,6 +32,14 @@ public:
     void convert(const std::string& outPath);
 
 private:
+    struct Scanner;
+
+    void scan(unsigned int index);
+    void scanDirectory(unsigned int index, const std::shared_ptr<const Directory>& directory);
+    void pushDirectory(unsigned int index, std::shared_ptr<const Directory>&& directory);
+    bool takeDirectory(unsigned int index, std::shared_ptr<const Directory>& directory);
+    void report(const std::string& message) const;
+
     static bool isMusic(const std::filesystem::path& path);
 
 private:
@@ -27,6 +47,17 @@ private:
     mutable uint32_t countMusical;
     mutable bool counted;
     std::shared_ptr<TaskManager> taskManager;
-    std::shared_ptr<Settings> settings; 
+    std::shared_ptr<Settings> settings;
+    std::shared_ptr<Printer> logger;
+
+    std::vector<std::unique_ptr<Scanner>> scanners;
+    std::atomic<std::size_t> pendingDirectories;    //queued and being scanned
+    std::atomic<std::size_t> queuedDirectories;     //waiting in some scanner queue
+    std::mutex idleMutex;
+    std::condition_variable idleConditional;
 };
 
+struct Collection::Scanner {
+    std::mutex mutex;
+    std::deque<std::shared_ptr<const Directory>> directories;
+};
@@ -0,0 +1,359 @@
+#include "copyengine.h"
+
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+
+constexpr std::size_t plainBufferSize = 1024 * 1024;
+constexpr std::size_t ringChunks = 4;                         //chunks read or written at the same time
+constexpr std::size_t rangeChunkSize = 1024 * 1024 * 1024;      //copy_file_range does at most that much in one call anyway
+
+static std::string describe(const std::string& action, const std::filesystem::path& path, int error) {
+    return "Couldn't " + action + " " + path.string() + ": " + std::strerror(error);
+}
+
+CopyEngine::CopyEngine(Settings::CopyMode mode):
+    mode(mode),
+    mutex(),
+    unsupported()
+{}
+
+CopyEngine::Result CopyEngine::copy(const std::filesystem::path& source, const std::filesystem::path& destination) {
+    int in = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in == -1)
+        return {false, plain, describe("open", source, errno)};
+
+    struct stat info;
+    if (::fstat(in, &info) == -1) {
+        int error = errno;
+        ::close(in);
+        return {false, plain, describe("stat", source, error)};
+    }
+
+    if (identical(info, destination)) {
+        ::close(in);
+        return {true, skipped, ""};
+    }
+
+    std::error_code ec;
+    std::error_code ignored;
+    std::string fallback;
+    std::filesystem::path temp = destination;       //the link takes the place of the old destination in one rename, it's never missing
+    temp += ".part";
+    switch (mode) {
+        case Settings::hardlink:
+            std::filesystem::remove(temp, ec);
+            std::filesystem::create_hard_link(source, temp, ec);
+            if (!ec)
+                std::filesystem::rename(temp, destination, ec);
+            if (!ec) {
+                ::close(in);
+                return {true, hardlink, ""};
+            }
+            std::filesystem::remove(temp, ignored);
+            fallback = "Couldn't hardlink " + destination.string() + ": " + ec.message();
+            break;
+        case Settings::symlink:
+            std::filesystem::remove(temp, ec);
+            std::filesystem::create_symlink(std::filesystem::absolute(source), temp, ec);
+            if (!ec)
+                std::filesystem::rename(temp, destination, ec);
+            if (!ec) {
+                ::close(in);
+                return {true, symlink, ""};
+            }
+            std::filesystem::remove(temp, ignored);
+            fallback = "Couldn't symlink " + destination.string() + ": " + ec.message();
+            break;
+        default:
+            break;
+    }
+
+    Result result = copyData(in, info, destination);
+    ::close(in);
+    if (result.success && !fallback.empty())
+        result.error = fallback;
+
+    return result;
+}
+
+CopyEngine::Result CopyEngine::copyData(int in, const struct stat& source, const std::filesystem::path& destination) {
+    std::filesystem::path temp = destination;       //renamed over the destination when it's complete, never writes through an old link
+    temp += ".part";
+    ::unlink(temp.c_str());
+    int out = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, source.st_mode & 07777);
+    if (out == -1)
+        return {false, plain, describe("create", temp, errno)};
+
+    struct stat target;
+    Filesystems filesystems(source.st_dev, source.st_dev);
+    if (::fstat(out, &target) == 0)
+        filesystems.second = target.st_dev;
+
+    std::string error;
+    Method method = plain;
+    bool done = false;
+    if (mode != Settings::range && mode != Settings::plain && tryReflink(in, out, filesystems)) {
+        method = reflink;
+        done = true;
+    }
+
+    if (!done && mode != Settings::plain && tryRange(in, out, source.st_size, filesystems, error)) {
+        method = range;
+        done = true;
+    }
+
+    if (!done && error.empty()) {
+        IORing* ring = IORing::forThread();
+        if (ring != nullptr && !isUnsupported(filesystems, noRing))
+            done = copyRing(*ring, in, out, source.st_size, filesystems, error);
+
+        if (!done && error.empty())
+            done = copyPlain(in, out, error);
+    }
+
+    if (done) {     //same size and time is how the next run knows it has nothing to do
+        struct timespec times[2] = {source.st_atim, source.st_mtim};
+        ::futimens(out, times);
+        if (::fsync(out) == -1) {
+            done = false;
+            error = std::strerror(errno);
+        }
+    }
+
+    if (::close(out) == -1 && done) {
+        done = false;
+        error = std::strerror(errno);
+    }
+
+    if (done && ::rename(temp.c_str(), destination.c_str()) == -1) {
+        done = false;
+        error = std::strerror(errno);
+    }
+
+    if (!done) {
+        ::unlink(temp.c_str());
+        return {false, method, "Couldn't copy to " + destination.string() + ": " + error};
+    }
+
+    Result result = {true, method, ""};
+    if (mode == Settings::reflink && method != reflink)
+        result.error = "Couldn't reflink " + destination.string() + ", the filesystem doesn't support it";
+
+    return result;
+}
+
+bool CopyEngine::tryReflink(int in, int out, const Filesystems& filesystems) {
+    if (filesystems.first != filesystems.second || isUnsupported(filesystems, noReflink))
+        return false;
+
+    if (::ioctl(out, FICLONE, in) == 0)
+        return true;
+
+    if (isUnsupportedError(errno))
+        markUnsupported(filesystems, noReflink);
+
+    return false;       //nothing is written yet, the other ways are still there
+}
+
+bool CopyEngine::tryRange(int in, int out, uint64_t size, const Filesystems& filesystems, std::string& error) {
+    if (isUnsupported(filesystems, noRange))
+        return false;
+
+    uint64_t copied = 0;
+    while (copied < size) {
+        ssize_t written = ::copy_file_range(in, nullptr, out, nullptr, std::min<uint64_t>(size - copied, rangeChunkSize), 0);
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+
+            if (copied == 0 && isUnsupportedError(errno)) {
+                markUnsupported(filesystems, noRange);
+                return false;
+            }
+
+            error = std::strerror(errno);
+            return false;
+        }
+
+        if (written == 0)
+            break;          //the source got shorter while we were copying, whatever is there is copied
+
+        copied += written;
+    }
+
+    return true;
+}
+
+bool CopyEngine::copyPlain(int in, int out, std::string& error) {
+    std::vector<char> buffer(plainBufferSize);
+    while (true) {
+        ssize_t read = ::read(in, buffer.data(), buffer.size());
+        if (read == 0)
+            return true;
+
+        if (read == -1) {
+            if (errno == EINTR)
+                continue;
+
+            error = std::strerror(errno);
+            return false;
+        }
+
+        for (ssize_t offset = 0; offset < read;) {
+            ssize_t written = ::write(out, buffer.data() + offset, read - offset);
+            if (written == -1) {
+                if (errno == EINTR)
+                    continue;
+
+                error = std::strerror(errno);
+                return false;
+            }
+            offset += written;
+        }
+    }
+}
+
+bool CopyEngine::isUnsupported(const Filesystems& filesystems, Unsupported what) {
+    std::lock_guard lock(mutex);
+    std::map<Filesystems, uint8_t>::const_iterator itr = unsupported.find(filesystems);
+    return itr != unsupported.end() && (itr->second & what) != 0;
+}
+
+void CopyEngine::markUnsupported(const Filesystems& filesystems, Unsupported what) {
+    std::lock_guard lock(mutex);
+    unsupported[filesystems] |= what;
+}
+
+bool CopyEngine::identical(const struct stat& source, const std::filesystem::path& destination) {
+    struct stat target;
+    if (::stat(destination.c_str(), &target) == -1)     //follows symlinks, a link to the source is the source
+        return false;
+
+    if (target.st_dev == source.st_dev && target.st_ino == source.st_ino)
+        return true;
+
+    return S_ISREG(target.st_mode)
+        && target.st_size == source.st_size
+        && target.st_mtim.tv_sec == source.st_mtim.tv_sec
+        && target.st_mtim.tv_nsec == source.st_mtim.tv_nsec;
+}
+
+bool CopyEngine::isUnsupportedError(int error) {
+    switch (error) {
+        case EOPNOTSUPP:
+        case ENOTTY:
+        case EINVAL:
+        case EXDEV:
+        case ENOSYS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::string_view CopyEngine::methodName(Method method) {
+    switch (method) {
+        case skipped:
+            return "nothing";
+        case reflink:
+            return "reflink";
+        case range:
+            return "copy_file_range";
+        case hardlink:
+            return "hardlink";
+        case symlink:
+            return "symlink";
+        case plain:
+            return "plain copy";
+    }
+
+    return "unknown";
+}
+
+bool CopyEngine::copyRing(IORing& ring, int in, int out, uint64_t size, const Filesystems& filesystems, std::string& error) {
+    struct Chunk {
+        std::vector<char> data;
+        uint64_t offset;
+        uint32_t length;
+        uint32_t done;          //bytes read, or written once it's writing
+        bool writing;
+    };
+
+    std::vector<Chunk> chunks(ringChunks);
+    uint64_t next = 0;
+    bool shorter = false;       //the source got shorter while we were copying, whatever is there is copied
+    bool unsupported = false;   //the kernel or the filesystem can't do it through the ring, the plain copy starts over
+    bool ok = true;
+    for (std::size_t i = 0; i < chunks.size() && next < size; ++i) {
+        Chunk& chunk = chunks[i];
+        chunk.data.resize(plainBufferSize);
+        chunk.offset = next;
+        chunk.length = std::min<uint64_t>(plainBufferSize, size - next);
+        chunk.done = 0;
+        chunk.writing = false;
+        ok = ring.read(in, chunk.data.data(), chunk.length, chunk.offset, i) && ok;
+        next += chunk.length;
+    }
+
+    while (std::optional<IORing::Completion> completion = ring.wait()) {
+        Chunk& chunk = chunks[completion->tag];
+        if (completion->result < 0) {
+            unsupported = unsupported || IORing::isUnsupported(completion->result);
+            if (!unsupported)
+                error = std::strerror(-completion->result);
+            ok = false;
+        }
+        if (!ok)
+            continue;       //the rest is only waited for, the kernel still uses the buffers
+
+        if (completion->result == 0) {
+            if (chunk.writing) {
+                error = "nothing was written";
+                ok = false;
+                continue;
+            }
+            shorter = true;
+            chunk.length = chunk.done;
+        }
+
+        chunk.done += completion->result;
+        if (!chunk.writing && chunk.done == chunk.length) {
+            chunk.writing = true;
+            chunk.done = 0;
+        }
+
+        if (chunk.done < chunk.length) {
+            if (chunk.writing)
+                ok = ring.write(out, chunk.data.data() + chunk.done, chunk.length - chunk.done, chunk.offset + chunk.done, completion->tag);
+            else
+                ok = ring.read(in, chunk.data.data() + chunk.done, chunk.length - chunk.done, chunk.offset + chunk.done, completion->tag);
+        } else if (!shorter && next < size) {      //written, the buffer takes the next chunk
+            chunk.offset = next;
+            chunk.length = std::min<uint64_t>(plainBufferSize, size - next);
+            chunk.done = 0;
+            chunk.writing = false;
+            ok = ring.read(in, chunk.data.data(), chunk.length, chunk.offset, completion->tag);
+            next += chunk.length;
+        }
+
+        if (!ok && error.empty() && !unsupported)
+            error = "Couldn't queue the copy to io_uring";
+    }
+
+    if (ring.inFlight() > 0) {
+        error = "Couldn't wait for io_uring";
+        return false;
+    }
+
+    if (unsupported && error.empty()) {
+        markUnsupported(filesystems, noRing);
+        ::ftruncate(out, 0);
+    }
+
+    return ok;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "settings.h"
+#include "ioring.h"
+
+//Mirrors one file with the cheapest way the filesystems allow.
+//In the automatic mode it tries to clone the extents (reflink), then lets the kernel copy (copy_file_range)
+//and only then copies through userspace buffers, several chunks at once through io_uring if it's on. What didn't work is remembered for every pair of filesystems,
+//so the next files go straight to the method that works there.
+//A destination that is the source itself or has the same size and modification time is left as it is
+class CopyEngine {
+public:
+    enum Method {
+        skipped,        //the destination was already identical
+        reflink,
+        range,
+        hardlink,
+        symlink,
+        plain
+    };
+
+    struct Result {
+        bool success;
+        Method method;
+        std::string error;      //why it failed, or why the requested mode didn't work if it fell back
+    };
+
+    CopyEngine(Settings::CopyMode mode);
+
+    Result copy(const std::filesystem::path& source, const std::filesystem::path& destination);
+
+    static std::string_view methodName(Method method);
+
+private:
+    enum Unsupported : uint8_t {
+        noReflink = 1 << 0,
+        noRange = 1 << 1,
+        noRing = 1 << 2
+    };
+    using Filesystems = std::pair<dev_t, dev_t>;
+
+    Result copyData(int in, const struct stat& source, const std::filesystem::path& destination);
+    bool tryReflink(int in, int out, const Filesystems& filesystems);
+    bool tryRange(int in, int out, uint64_t size, const Filesystems& filesystems, std::string& error);
+    bool copyPlain(int in, int out, std::string& error);
+    bool copyRing(IORing& ring, int in, int out, uint64_t size, const Filesystems& filesystems, std::string& error);
+    bool isUnsupported(const Filesystems& filesystems, Unsupported what);
+    void markUnsupported(const Filesystems& filesystems, Unsupported what);
+
+    static bool identical(const struct stat& source, const std::filesystem::path& destination);
+    static bool isUnsupportedError(int error);
+
+private:
+    const Settings::CopyMode mode;
+    std::mutex mutex;
+    std::map<Filesystems, uint8_t> unsupported;
+};
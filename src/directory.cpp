@@ -0,0 +1,27 @@
+#include "directory.h"
+
+Directory::Directory(const std::filesystem::path& source, const std::filesystem::path& destination):
+    parent(nullptr),
+    name(source.string()),
+    destinationRoot(destination.string())
+{}
+
+Directory::Directory(const std::shared_ptr<const Directory>& parent, const std::string& name):
+    parent(parent),
+    name(name),
+    destinationRoot()
+{}
+
+std::filesystem::path Directory::source() const {
+    if (parent)
+        return parent->source() / name;
+    else
+        return name;
+}
+
+std::filesystem::path Directory::destination() const {
+    if (parent)
+        return parent->destination() / name;
+    else
+        return destinationRoot;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <filesystem>
+
+//A node of the source tree, the destination tree mirrors it.
+//Nodes keep only their own name and share their parent,
+//so queued files cost only their names, not their full paths
+class Directory {
+public:
+    Directory(const std::filesystem::path& source, const std::filesystem::path& destination);
+    Directory(const std::shared_ptr<const Directory>& parent, const std::string& name);
+
+    std::filesystem::path source() const;
+    std::filesystem::path destination() const;
+
+private:
+    std::shared_ptr<const Directory> parent;
+    std::string name;               //for the root it's the source path
+    std::string destinationRoot;    //empty for anyone but the root
+};
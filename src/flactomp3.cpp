@@ -1,12 +1,22 @@
 #include "flactomp3.h"
 
 #include <cmath>
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
 
 #include <tpropertymap.h>
 #include <attachedpictureframe.h>
 #include <textidentificationframe.h>
 
+#include "mp3frame.h"
+#include "trace.h"
+
 constexpr uint16_t flacDefaultMaxBlockSize = 4096;
+constexpr uint32_t segmentOverlapFrames = 16;     //primes the psychoacoustic model and the filterbank of every next segment
+constexpr uint32_t shortestSegment = 30;          //seconds, shorter ones don't pay for the overlap and the threads
+constexpr std::size_t maxMP3FrameSize = 2881;
+constexpr std::size_t pipelineDepth = 4;          //blocks in flight between two stages
 
 constexpr std::string_view jpeg ("image/jpeg");
 const std::map<std::string, std::string> textIdentificationReplacements({
@@ -24,73 +34,427 @@ constexpr std::array<int, 10> bitrates({
     64,
     32
 });
+constexpr std::array<uint32_t, 10> vbrBitrates({     //what LAME averages to on a stereo music for every VBR quality, kbps
+    245,
+    225,
+    190,
+    175,
+    165,
+    130,
+    115,
+    100,
+    85,
+    65
+});
 
 FLACtoMP3::FLACtoMP3(Logger::Severity severity, uint8_t size) :
     logger(severity),
     inPath(),
     outPath(),
+    tempPath(),
     decoder(FLAC__stream_decoder_new()),
     encoder(lame_init()),
     statusFLAC(),
-    output(nullptr),
+    input(),
+    output(),
+    tagPosition(0),
     bufferMultiplier(size),
     flacMaxBlockSize(0),
     pcmCounter(0),
     pcmSize(0),
-    pcm(nullptr),
+    pcm(),
+    converter(),
     outputBuffer(nullptr),
     outputBufferSize(0),
     outputInitilized(false),
     downscaleAlbumArt(false),
-    id3v2tag()
+    streamMD5(),
+    tagDigest(Manifest::noTags),
+    id3v2tag(std::make_unique<TagLib::ID3v2::Tag>()),
+    encodingQuality(0),
+    outputQuality(0),
+    vbr(false),
+    splitLongerThan(0),
+    maxSegments(1),
+    sampleRate(0),
+    totalSamples(0),
+    seekPoints(),
+    outputRate(0),
+    polyphase(false),
+    resampler(),
+    segment(std::nullopt),
+    decodedSamples(0),
+    segmentComplete(false),
+    frameIndex(0),
+    pendingFrames(),
+    frameSizes(),
+    lameTag(),
+    pipelined(false),
+    pipeline(),
+    timing()
 {
 }
 
 FLACtoMP3::~FLACtoMP3() {
+    if (pipeline)
+        stopPipeline();
+
     lame_close(encoder);
     FLAC__stream_decoder_delete(decoder);
+    delete[] outputBuffer;
+}
+
+void FLACtoMP3::reset() {
+    if (pipeline)
+        stopPipeline();
+
+    if (outputInitilized)
+        releaseOutput(false);
+
+    FLAC__stream_decoder_finish(decoder);       //uninitialized again, the decoder and its buffers are kept
+    lame_close(encoder);                        //LAME can't take new parameters once they are initialized
+    encoder = lame_init();
+    input.close();
+
+    inPath.clear();
+    outPath.clear();
+    tempPath.clear();
+    statusFLAC = FLAC__StreamDecoderInitStatus();
+    tagPosition = 0;
+    flacMaxBlockSize = 0;
+    pcmCounter = 0;
+    downscaleAlbumArt = false;
+    streamMD5.fill(0);
+    tagDigest = Manifest::noTags;
+    id3v2tag = std::make_unique<TagLib::ID3v2::Tag>();
+    sampleRate = 0;
+    totalSamples = 0;
+    seekPoints.clear();
+    resampler.setRates(0, 0, 0);
+    segment.reset();
+    decodedSamples = 0;
+    segmentComplete = false;
+    frameIndex = 0;
+    pendingFrames.clear();
+    frameSizes.clear();
+    lameTag.clear();
+    timing.clear();
+    logger.takeHistory();
+}
+
+static std::string mebibytes(uint64_t bytes) {
+    float MBytes = (float)bytes / 1024 / 1024;
+    std::string strMBytes = std::to_string(MBytes);
+    return strMBytes.substr(0, strMBytes.find(".") + 3) + " MiB";
 }
 
 bool FLACtoMP3::run() {
-    FLAC__bool ok = FLAC__stream_decoder_process_until_end_of_stream(decoder);
+    Timing::Scope scope(timing, Timing::decode);     //whatever the other stages don't take
+    FLAC__bool ok = FLAC__stream_decoder_process_until_end_of_metadata(decoder);
+    if (ok && maxSegments > 1 && splitLongerThan > 0 && totalSamples >= uint64_t(splitLongerThan) * sampleRate)
+        return runSegmented();
+
+    if (ok)
+        ok = FLAC__stream_decoder_process_until_end_of_stream(decoder);
+
+    return finish(ok);
+}
+
+bool FLACtoMP3::finish(bool ok) {
     uint32_t fileSize;
-    if (ok) {
-        if (pcmCounter > 0)
-            flush();
+    if (ok && resampler.isActive()) {
+        resampler.drain();
+        ok = resample();
+    }
 
-        int nwrite = lame_encode_flush(encoder, outputBuffer, outputBufferSize);
-        fwrite((char*)outputBuffer, nwrite, 1, output);
+    if (ok && pcmCounter > 0)
+        flush();
 
+    if (pipeline) {
+        ok = stopPipeline() && ok;      //the encoder stage flushes LAME itself once the decoder is done
+    } else if (ok) {
+        Timing::Scope scope(timing, Timing::encode);
+        int nwrite = lame_encode_flush(encoder, outputBuffer, outputBufferSize);
+        if (nwrite > 0)
+            writeEncoded(outputBuffer, nwrite);
+    }
 
-        fileSize = ftell(output);
-        lame_mp3_tags_fid(encoder, output);
+    if (ok) {
+        Timing::Scope scope(timing, Timing::write);
+        fileSize = output.tell();
+        if (lame_get_bWriteVbrTag(encoder)) {       //the first block is still in memory, it's patched there
+            std::array<uint8_t, maxMP3FrameSize> tag;
+            std::size_t size = lame_get_lametag_frame(encoder, tag.data(), tag.size());
+            if (size > 0 && size <= tag.size() && !output.patch(tagPosition, tag.data(), size)) {
+                logger.fatal("Error writing file ", outPath);
+                ok = false;
+            }
+        }
     }
 
     // std::cout << "   state: " << FLAC__StreamDecoderStateString[FLAC__stream_decoder_get_state(decoder)] << std::endl;
 
     if (outputInitilized) {
-        fclose(output);
-        output = nullptr;
+        ok = releaseOutput(ok);
+        if (ok)
+            logger.info("resulting file size: ", mebibytes(fileSize));
 
-        delete[] pcm;
-        delete[] outputBuffer;
+        return ok;
+    }
+
+    return false;
+}
+
+bool FLACtoMP3::releaseOutput(bool keep) {
+    Timing::Scope scope(timing, Timing::write);
+    if (keep)
+        keep = output.finish(!segment.has_value());     //the data has to be on the disk before the name points to it
+
+    keep = output.close() && keep;
+
+    pcm.clear();        //the capacity and the output buffer are left for the next file
+    pcmSize = 0;
+    flacMaxBlockSize = 0;
+    outputInitilized = false;
+
+    if (segment.has_value())
+        return keep;                //the whole file convertor removes them after stitching
+
+    if (keep && std::rename(tempPath.c_str(), outPath.c_str()) == 0)
+        return true;
+
+    if (keep)
+        logger.fatal("Error renaming ", tempPath, " to ", outPath);
+
+    std::remove(tempPath.c_str());
+    return false;
+}
+
+uint64_t FLACtoMP3::estimateSize() const {
+    if (totalSamples == 0 || sampleRate == 0)
+        return 0;
+
+    uint64_t bitrate = lame_get_brate(encoder);
+    if (vbr) {
+        bitrate = vbrBitrates[std::min<std::size_t>(outputQuality, vbrBitrates.size() - 1)];
+        if (converter.getOutputChannels() == 1)
+            bitrate = bitrate * 6 / 10;
+    }
+
+    return totalSamples * bitrate * 125 / sampleRate;      //kbps to bytes per second
+}
+
+bool FLACtoMP3::runSegmented() {
+    if (!initializeOutput())
+        return false;
+
+    std::vector<Segment> plan;
+    if (lame_get_out_samplerate(encoder) == static_cast<int>(sampleRate))   //resampling would move the frame grid off the seek points
+        plan = planSegments(lame_get_framesize(encoder));
+
+    if (plan.size() < 2)
+        return finish(FLAC__stream_decoder_process_until_end_of_stream(decoder));
+
+    logger.info("encoding ", plan.size(), " segments in parallel");
+    Logger::Severity severity = std::max(logger.getSeverity(), Logger::Severity::warning);  //the parts would only repeat what is already said
+    std::vector<std::unique_ptr<FLACtoMP3>> parts;
+    for (std::size_t i = 0; i < plan.size(); ++i) {
+        std::unique_ptr<FLACtoMP3> part = std::make_unique<FLACtoMP3>(severity, bufferMultiplier);
+        part->segment = plan[i];
+        part->setInputFile(inPath);
+        part->setOutputFile(segmentPath(i));
+        part->setParameters(encodingQuality, outputQuality, vbr);
+        part->setResampling(outputRate, polyphase);     //the parts only run if nothing is resampled, but LAME has to pick the same rate
+        parts.push_back(std::move(part));
+    }
+
+    std::vector<uint8_t> results(parts.size(), false);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < parts.size(); ++i)
+        threads.emplace_back([&results, &parts, i] () {
+            Trace::nameThread("segment " + std::to_string(i));
+            results[i] = parts[i]->encodeSegment();
+        });
+
+    results[0] = parts[0]->encodeSegment();
+    for (std::thread& thread : threads)
+        thread.join();
+
+    bool ok = true;
+    for (std::size_t i = 0; i < parts.size(); ++i) {
+        logger.append(parts[i]->takeHistory());
+        timing.add(parts[i]->getTimings());
+        ok = ok && results[i];
+    }
+
+    if (ok)
+        ok = stitch(parts);
+
+    for (const std::unique_ptr<FLACtoMP3>& part : parts)
+        remove(part->outPath.c_str());
+
+    for (std::size_t i = parts.size(); remove(segmentPath(i).c_str()) == 0; ++i);      //left by an interrupted run that had more threads
+
+    uint64_t fileSize = output.tell();
+    ok = releaseOutput(ok);
+    if (ok)
+        logger.info("resulting file size: ", mebibytes(fileSize));
+
+    return ok;
+}
 
-        pcm = nullptr;
-        outputBuffer = nullptr;
-        pcmSize = 0;
-        flacMaxBlockSize = 0;
-        outputBufferSize = 0;
-        if (ok) {
-            float MBytes = (float)fileSize / 1024 / 1024;
-            std::string strMBytes = std::to_string(MBytes);
-            strMBytes = strMBytes.substr(0, strMBytes.find(".") + 3) + " MiB";
-            logger.info("resulting file size: " + strMBytes);
+std::string FLACtoMP3::segmentPath(std::size_t index) const {
+    return outPath + ".segment" + std::to_string(index) + ".part";
+}
+
+std::vector<FLACtoMP3::Segment> FLACtoMP3::planSegments(uint32_t frameSize) const {
+    std::vector<Segment> result;
+    if (frameSize == 0 || sampleRate == 0)
+        return result;
+
+    uint64_t overlap = uint64_t(segmentOverlapFrames) * frameSize;
+    uint64_t shortest = uint64_t(shortestSegment) * sampleRate;
+    uint64_t count = std::min<uint64_t>(maxSegments, totalSamples / shortest);
+
+    std::vector<uint64_t> bounds({0});
+    for (uint64_t i = 1; i < count; ++i) {
+        uint64_t bound = totalSamples * i / count;
+        if (!seekPoints.empty()) {      //the decoder jumps to a seek point right away, anywhere else it has to search
+            std::vector<uint64_t>::const_iterator point = std::lower_bound(seekPoints.begin(), seekPoints.end(), bound);
+            if (point == seekPoints.end() || (point != seekPoints.begin() && bound - *(point - 1) < *point - bound))
+                --point;
+
+            bound = *point;
         }
+        bound -= bound % frameSize;     //every segment has to start on the frame grid of the whole file
 
-        return ok;
+        if (bound >= bounds.back() + shortest / 2 && bound + shortest / 2 <= totalSamples)
+            bounds.push_back(bound);
     }
 
-    return false;
+    if (bounds.size() < 2)
+        return result;
+
+    bounds.push_back(totalSamples);
+    for (std::size_t i = 0; i + 1 < bounds.size(); ++i) {
+        bool first = i == 0;
+        bool last = i + 2 == bounds.size();
+
+        Segment part;
+        part.first = first;
+        part.from = first ? 0 : bounds[i] - overlap;
+        part.to = last ? 0 : bounds[i + 1] + overlap;
+        part.keepFrom = first ? 0 : segmentOverlapFrames;
+        part.keepTo = last ? 0 : part.keepFrom + (bounds[i + 1] - bounds[i]) / frameSize;
+        result.push_back(part);
+    }
+
+    return result;
+}
+
+bool FLACtoMP3::encodeSegment() {
+    Timing::Scope scope(timing, Timing::decode);
+    bool ok = FLAC__stream_decoder_process_until_end_of_metadata(decoder);
+    if (!segment->first)
+        lame_set_bWriteVbrTag(encoder, 0);      //there is only one tag, it comes from the first segment
+
+    lame_set_disable_reservoir(encoder, !segment->first);     //the first kept frame can't borrow bits from the dropped ones
+    if (ok)
+        ok = initializeOutput();
+
+    if (ok && lame_get_bWriteVbrTag(encoder)) {     //the placeholder for the tag goes first, it's not audio
+        ++segment->keepFrom;
+        if (segment->keepTo != 0)
+            ++segment->keepTo;
+    }
+
+    decodedSamples = segment->from;
+    if (ok && segment->from > 0)
+        ok = FLAC__stream_decoder_seek_absolute(decoder, segment->from);
+
+    while (ok && !segmentComplete && FLAC__stream_decoder_get_state(decoder) != FLAC__STREAM_DECODER_END_OF_STREAM)
+        ok = FLAC__stream_decoder_process_single(decoder);
+
+    if (ok && pcmCounter > 0)
+        ok = flush();
+
+    if (ok) {
+        int nwrite = lame_encode_flush(encoder, outputBuffer, outputBufferSize);
+        ok = nwrite >= 0 && writeEncoded(outputBuffer, nwrite);
+    }
+
+    if (ok && !pendingFrames.empty()) {
+        logger.fatal("encoder left an incomplete frame at the end of the segment");
+        ok = false;
+    }
+
+    if (ok && lame_get_bWriteVbrTag(encoder)) {
+        lameTag.resize(maxMP3FrameSize);
+        std::size_t size = lame_get_lametag_frame(encoder, lameTag.data(), lameTag.size());
+        lameTag.resize(size <= lameTag.size() ? size : 0);
+    }
+
+    if (outputInitilized)
+        ok = releaseOutput(ok);
+
+    return ok;
+}
+
+bool FLACtoMP3::stitch(std::vector<std::unique_ptr<FLACtoMP3>>& parts) {
+    Timing::Scope scope(timing, Timing::write);
+    std::vector<uint8_t> tag = parts.front()->lameTag;
+    if (!tag.empty() && !output.write(tag.data(), tag.size())) {
+        logger.fatal("Error writing file ", outPath);
+        return false;
+    }
+
+    std::vector<uint32_t> sizes;
+    uint64_t audioBytes = 0;
+    uint16_t musicCRC = 0;
+    for (const std::unique_ptr<FLACtoMP3>& part : parts) {
+        FILE* input = fopen(part->outPath.c_str(), "rb");
+        if (input == nullptr) {
+            logger.fatal("Error opening file ", part->outPath);
+            return false;
+        }
+
+        bool ok = true;
+        std::size_t read;
+        while (ok && (read = fread(outputBuffer, 1, outputBufferSize, input)) > 0) {
+            musicCRC = MP3Frame::crc(outputBuffer, read, musicCRC);
+            audioBytes += read;
+            ok = output.write(outputBuffer, read);
+        }
+        fclose(input);
+        if (!ok) {
+            logger.fatal("Error writing file ", outPath);
+            return false;
+        }
+
+        sizes.insert(sizes.end(), part->frameSizes.begin(), part->frameSizes.end());
+    }
+
+    if (tag.empty())
+        return true;
+
+    MP3Frame::Info info;
+    info.frames = sizes.size();
+    info.bytes = tag.size() + audioBytes;
+    info.toc = MP3Frame::toc(sizes, tag.size(), info.bytes);
+    info.delay = lame_get_encoder_delay(encoder);
+    uint64_t samples = uint64_t(sizes.size()) * lame_get_framesize(encoder);
+    info.padding = samples > totalSamples + info.delay ? samples - totalSamples - info.delay : 0;
+    info.musicCRC = musicCRC;
+    if (!MP3Frame::patchInfoTag(tag, info)) {
+        logger.warn("couldn't update the LAME tag, the duration and the gapless playback might be off");
+        return true;
+    }
+
+    bool ok = output.patch(tagPosition, tag.data(), tag.size());
+    if (!ok)
+        logger.fatal("Error writing file ", outPath);
+
+    return ok;
 }
 
 void FLACtoMP3::setInputFile(const std::string& path) {
@@ -99,9 +463,20 @@ void FLACtoMP3::setInputFile(const std::string& path) {
 
     inPath = path;
 
-    FLAC__stream_decoder_set_md5_checking(decoder, true);
-    FLAC__stream_decoder_set_metadata_respond_all(decoder);
-    statusFLAC = FLAC__stream_decoder_init_file(decoder, path.c_str(), write, metadata, error, this);
+    if (segment.has_value()) {      //seeking turns the MD5 check off anyway, the tags go from the whole file
+        FLAC__stream_decoder_set_md5_checking(decoder, false);
+        FLAC__stream_decoder_set_metadata_ignore_all(decoder);
+        FLAC__stream_decoder_set_metadata_respond(decoder, FLAC__METADATA_TYPE_STREAMINFO);
+    } else {
+        FLAC__stream_decoder_set_md5_checking(decoder, true);
+        FLAC__stream_decoder_set_metadata_respond_all(decoder);
+    }
+    if (!input.open(path)) {
+        statusFLAC = FLAC__STREAM_DECODER_INIT_STATUS_ERROR_OPENING_FILE;
+        logger.fatal("Error opening file ", path);
+        return;
+    }
+    statusFLAC = FLAC__stream_decoder_init_stream(decoder, readInput, seekInput, tellInput, lengthInput, eofInput, write, metadata, error, this);
 }
 
 void FLACtoMP3::setOutputFile(const std::string& path) {
@@ -113,13 +488,17 @@ void FLACtoMP3::setOutputFile(const std::string& path) {
 }
 
 void FLACtoMP3::setParameters(unsigned char encodingQuality, unsigned char outputQuality, bool vbr) {
+    FLACtoMP3::encodingQuality = encodingQuality;
+    FLACtoMP3::outputQuality = outputQuality;
+    FLACtoMP3::vbr = vbr;
+
     if (vbr) {
-        logger.info("Encoding to VBR with quality " + std::to_string(outputQuality));
+        logger.info("Encoding to VBR with quality ", outputQuality);
         lame_set_VBR(encoder, vbr_default);
         lame_set_VBR_quality(encoder, outputQuality);
     } else {
         int bitrate = bitrates[outputQuality];
-        logger.info("Encoding to CBR " + std::to_string(bitrate));
+        logger.info("Encoding to CBR ", bitrate);
         lame_set_VBR(encoder, vbr_off);
         lame_set_brate(encoder, bitrate);
     }
@@ -127,36 +506,58 @@ void FLACtoMP3::setParameters(unsigned char encodingQuality, unsigned char outpu
     lame_set_quality(encoder, encodingQuality);
 }
 
+void FLACtoMP3::setPipelined(bool pipelined) {
+    FLACtoMP3::pipelined = pipelined;
+}
+
+void FLACtoMP3::setResampling(uint32_t outputRate, bool polyphase) {
+    FLACtoMP3::outputRate = outputRate;
+    FLACtoMP3::polyphase = polyphase;
+}
+
+void FLACtoMP3::setSegmentation(uint32_t splitLongerThan, unsigned int maxSegments) {
+    FLACtoMP3::splitLongerThan = splitLongerThan;
+    FLACtoMP3::maxSegments = maxSegments;
+}
+
 bool FLACtoMP3::initializeOutput() {
     if (outputInitilized)
         throw 5;
 
-    output = fopen(outPath.c_str(), "w+b");
-    if (output == 0) {
-        output = nullptr;
-        logger.fatal("Error opening file " + outPath);
+    tempPath = segment.has_value() ? outPath : outPath + ".part";     //segments are temporary anyway
+    if (!output.open(tempPath)) {
+        logger.fatal("Error opening file ", tempPath);
         return false;
     }
 
     int ret = lame_init_params(encoder);
     if (ret < 0) {
-        logger.fatal("Error initializing LAME parameters. Code = " + std::to_string(ret));
-        fclose(output);
-        output = nullptr;
+        logger.fatal("Error initializing LAME parameters. Code = ", ret);
+        output.close();
+        std::remove(tempPath.c_str());
         return false;
     }
 
     if (flacMaxBlockSize == 0)
         flacMaxBlockSize = flacDefaultMaxBlockSize;
 
-    pcmSize = lame_get_num_channels(encoder) * flacMaxBlockSize * bufferMultiplier;
-    outputBufferSize = pcmSize / 2;
+    pcmSize = flacMaxBlockSize * bufferMultiplier;
 
-    TagLib::ByteVector vector = id3v2tag.render();
-    fwrite((const char*)vector.data(), vector.size(), 1, output);
+    if (!segment.has_value()) {
+        Timing::Scope scope(timing, Timing::metadata);
+        TagLib::ByteVector vector = id3v2tag->render();
+        output.write((const uint8_t*)vector.data(), vector.size());
+    }
+    tagPosition = output.tell();
+    if (!segment.has_value())
+        output.reserve(tagPosition + estimateSize());
 
-    pcm = new int16_t[pcmSize];
-    outputBuffer = new uint8_t[outputBufferSize];
+    pcm.resize(pcmSize * 2);
+    if (outputBufferSize < pcmSize) {
+        delete[] outputBuffer;
+        outputBufferSize = pcmSize;
+        outputBuffer = new uint8_t[outputBufferSize];
+    }
 
     outputInitilized = true;
 
@@ -164,12 +565,41 @@ bool FLACtoMP3::initializeOutput() {
 }
 
 void FLACtoMP3::processInfo(const FLAC__StreamMetadata_StreamInfo& info) {
-    lame_set_in_samplerate(encoder, info.sample_rate);
-    lame_set_num_channels(encoder, info.channels);
+    converter.setFormat(info.channels, info.bits_per_sample);
+    uint32_t targetRate = outputRate != 0 ? outputRate : mp3Rate(info.sample_rate);
+    if (polyphase && resampler.setRates(info.sample_rate, targetRate, converter.getOutputChannels())) {
+        logger.info("resampling to ", targetRate);
+        lame_set_in_samplerate(encoder, targetRate);     //LAME only sees the resampled audio
+        lame_set_out_samplerate(encoder, targetRate);    //and would resample it a second time for the low bitrates
+    } else {
+        lame_set_in_samplerate(encoder, info.sample_rate);
+        if (outputRate != 0)    //otherwise LAME picks it for the bitrate, as it always has
+            lame_set_out_samplerate(encoder, outputRate);
+    }
+
+    lame_set_num_channels(encoder, converter.getOutputChannels());
+    if (converter.getOutputChannels() == 1)
+        lame_set_mode(encoder, MONO);       //one channel to analyze and code instead of two identical ones
+
     flacMaxBlockSize = info.max_blocksize;
-    logger.info("sample rate: " + std::to_string(info.sample_rate));
-    logger.info("channels: " + std::to_string(info.channels));
-    logger.info("bits per sample: " + std::to_string(info.bits_per_sample));
+    sampleRate = info.sample_rate;
+    totalSamples = info.total_samples;
+    std::copy(info.md5sum, info.md5sum + streamMD5.size(), streamMD5.begin());
+    logger.info("sample rate: ", info.sample_rate);
+    logger.info("channels: ", info.channels);
+    if (info.channels > 2)
+        logger.info("mixing down to stereo");
+    logger.info("bits per sample: ", info.bits_per_sample);
+}
+
+void FLACtoMP3::processSeekTable(const FLAC__StreamMetadata_SeekTable& table) {
+    seekPoints.clear();
+    for (uint32_t i = 0; i < table.num_points; ++i) {
+        const FLAC__StreamMetadata_SeekPoint& point = table.points[i];
+        if (point.sample_number != FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER)
+            seekPoints.push_back(point.sample_number);
+    }
+    std::sort(seekPoints.begin(), seekPoints.end());
 }
 
 void FLACtoMP3::processTags(const FLAC__StreamMetadata_VorbisComment& tags) {
@@ -180,7 +610,7 @@ void FLACtoMP3::processTags(const FLAC__StreamMetadata_VorbisComment& tags) {
         std::string_view comm((const char*)entry.entry);
         std::string_view::size_type ePos = comm.find("=");
         if (ePos == std::string_view::npos) {
-            logger.warn("couldn't understand tag (" + std::string(comm) + "), symbol '=' is missing, skipping");
+            logger.warn("couldn't understand tag (", comm, "), symbol '=' is missing, skipping");
             continue;
         }
         std::string key(comm.substr(0, ePos));
@@ -198,29 +628,29 @@ void FLACtoMP3::processTags(const FLAC__StreamMetadata_VorbisComment& tags) {
             TagLib::ID3v2::TextIdentificationFrame* frame = new TagLib::ID3v2::TextIdentificationFrame(itr->second.c_str());
             frame->setText(value);
             customFrames.push_back(frame);
-            logger.debug("tag \"" + key + "\" was remapped to \"" + itr->second + "\"");
+            logger.debug("tag \"", key, "\" was remapped to \"", itr->second, "\"");
         } else {
             success = props.insert(key, TagLib::String(value, TagLib::String::UTF8));
         }
 
         if (!success)
-            logger.warn("couldn't understand tag (" + key + "), skipping");
+            logger.warn("couldn't understand tag (", key, "), skipping");
     }
     TagLib::StringList unsupported = props.unsupportedData();
     for (const TagLib::String& key : unsupported)
-        logger.minor("tag \"" + key.to8Bit() + "\", is not supported, probably won't display well");
+        logger.minor("tag \"", key.to8Bit(), "\", is not supported, probably won't display well");
 
-    id3v2tag.setProperties(props);
+    id3v2tag->setProperties(props);
 
     for (TagLib::ID3v2::Frame* frame : customFrames)
-            id3v2tag.addFrame(frame);
+            id3v2tag->addFrame(frame);
 
 }
 
 void FLACtoMP3::processPicture(const FLAC__StreamMetadata_Picture& picture) {
     if (downscaleAlbumArt && picture.data_length > LAME_MAXALBUMART) {
-        logger.info("embeded album art is too big (" + std::to_string(picture.data_length) + " bytes), rescaling");
-        logger.debug("mime type is " + std::string(picture.mime_type));
+        logger.info("embeded album art is too big (", picture.data_length, " bytes), rescaling");
+        logger.debug("mime type is ", picture.mime_type);
         if (picture.mime_type == jpeg) {
             if (scaleJPEG(picture))
                 logger.debug("successfully rescaled album art");
@@ -235,6 +665,7 @@ void FLACtoMP3::processPicture(const FLAC__StreamMetadata_Picture& picture) {
 }
 
 bool FLACtoMP3::scaleJPEG(const FLAC__StreamMetadata_Picture& picture) {
+    Trace::Span span("picture", "scaleJPEG");
     struct jpeg_decompress_struct dinfo;
     struct jpeg_error_mgr derr;
 
@@ -301,75 +732,266 @@ bool FLACtoMP3::decodeFrame(const int32_t * const buffer[], uint32_t size) {
             return false;
     }
 
-    for (size_t i = 0; i < size; ++i) {
-        pcm[pcmCounter++] = (int16_t)buffer[0][i];
-        pcm[pcmCounter++] = (int16_t)buffer[1][i];
+    if (segment.has_value()) {
+        if (segmentComplete)
+            return true;
 
-        if (pcmCounter == pcmSize)
-            return flush();
+        if (segment->to != 0 && decodedSamples + size >= segment->to) {
+            size = segment->to - decodedSamples;
+            segmentComplete = true;
+        }
+        decodedSamples += size;
+    }
+
+    Timing::Scope scope(timing, Timing::pcm);     //the encoding in flush is taken out of it
+    if (resampler.isActive()) {
+        std::array<float*, Resampler::maxChannels> input = resampler.prepare(size);
+        converter.convert(buffer, 0, input[0], input[1], size);
+        resampler.push(size);
+        return resample();
+    }
+
+    for (uint32_t done = 0; done < size;) {
+        uint32_t frames = std::min(size - done, pcmSize - pcmCounter);
+        converter.convert(buffer, done, pcm.data() + pcmCounter, pcm.data() + pcmSize + pcmCounter, frames);
+        pcmCounter += frames;
+        done += frames;
+
+        if (pcmCounter == pcmSize && !flush())     //the rest of the frame still has to go to the buffer
+            return false;
+    }
+
+    return true;
+}
+
+bool FLACtoMP3::resample() {
+    Timing::Scope scope(timing, Timing::resample);
+    while (std::size_t frames = resampler.pull(pcm.data() + pcmCounter, pcm.data() + pcmSize + pcmCounter, pcmSize - pcmCounter)) {
+        pcmCounter += frames;
+        if (pcmCounter == pcmSize && !flush())
+            return false;
     }
 
     return true;
 }
 
 bool FLACtoMP3::flush() {
-    int nwrite = lame_encode_buffer_interleaved(
+    if (pipelined) {
+        if (!pipeline)
+            startPipeline();
+
+        if (pcmCounter < pcmSize) {      //only the last block, the right channel moves to its new middle
+            std::copy(pcm.begin() + pcmSize, pcm.begin() + pcmSize + pcmCounter, pcm.begin() + pcmCounter);
+            pcm.resize(pcmCounter * 2);
+        }
+        bool ok = pipeline->pcm.push(std::move(pcm));
+        pcm = pipeline->freePCM.tryPop().value_or(std::vector<float>());
+        pcm.resize(pcmSize * 2);
+        pcmCounter = 0;
+        return ok;      //false means one of the next stages has failed, the reason is already logged
+    }
+
+    Timing::Scope scope(timing, Timing::encode);
+    int nwrite = lame_encode_buffer_ieee_float(
         encoder,
-        pcm,
-        pcmCounter / 2,
+        pcm.data(),
+        pcm.data() + pcmSize,
+        pcmCounter,
         outputBuffer,
         outputBufferSize
     );
     while (nwrite == -1) {      //-1 is returned when there was not enough space in the given buffer
-        logger.major(std::to_string(outputBufferSize) + " bytes in the output buffer wasn't enough");;
+        logger.major(outputBufferSize, " bytes in the output buffer wasn't enough");
         outputBufferSize = outputBufferSize * 2;
         delete[] outputBuffer;
         outputBuffer = new uint8_t[outputBufferSize];
-        logger.major("allocating " + std::to_string(outputBufferSize) + " bytes");
+        logger.major("allocating ", outputBufferSize, " bytes");
 
-        nwrite = lame_encode_buffer_interleaved(
+        nwrite = lame_encode_buffer_ieee_float(
             encoder,
-            pcm,
-            pcmCounter / 2,
+            pcm.data(),
+            pcm.data() + pcmSize,
+            pcmCounter,
             outputBuffer,
             outputBufferSize
         );
     }
 
+    pcmCounter = 0;
     if (nwrite > 0) {
-        int actuallyWritten = fwrite((char*)outputBuffer, nwrite, 1, output);
-        pcmCounter = 0;
-        return actuallyWritten == 1;
+        return writeEncoded(outputBuffer, nwrite);
     } else {
         if (nwrite == 0) {
             logger.minor("encoding flush encoded 0 bytes, skipping write");
             return true;
         } else {
-            logger.fatal("encoding flush failed. Code = : " + std::to_string(nwrite));
+            logger.fatal("encoding flush failed. Code = : ", nwrite);
+            return false;
+        }
+    }
+}
+
+void FLACtoMP3::startPipeline() {
+    pipeline = std::make_unique<Pipeline>(pipelineDepth);
+    pipeline->encoder = std::thread(&FLACtoMP3::encodeStage, this);
+    pipeline->writer = std::thread(&FLACtoMP3::writeStage, this);
+}
+
+bool FLACtoMP3::stopPipeline() {
+    pipeline->pcm.close();          //the encoder still drains what is left
+    pipeline->encoder.join();
+    pipeline->writer.join();
+
+    bool ok = !pipeline->failed;
+    pipeline.reset();
+    return ok;
+}
+
+void FLACtoMP3::encodeStage() {
+    Trace::nameThread("pipeline encoder");
+    bool ok = true;
+    while (ok) {
+        std::optional<std::vector<float>> block = pipeline->pcm.pop();
+        if (!block.has_value())
+            break;
+
+        uint32_t samples = block->size() / 2;
+        std::vector<uint8_t> encoded = pipeline->freeMP3.tryPop().value_or(std::vector<uint8_t>());
+        encoded.resize(samples * 5 / 4 + 7200);     //the worst case LAME documents, so it never runs out of space
+        int nwrite;
+        {
+            Timing::Scope scope(timing, Timing::encode);
+            nwrite = lame_encode_buffer_ieee_float(encoder, block->data(), block->data() + samples, samples, encoded.data(), encoded.size());
+        }
+        pipeline->freePCM.tryPush(std::move(*block));
+        if (nwrite < 0) {
+            logger.fatal("encoding failed. Code = : ", nwrite);
+            ok = false;
+        } else if (nwrite > 0) {
+            encoded.resize(nwrite);
+            ok = pipeline->mp3.push(std::move(encoded));
+        }
+    }
+
+    if (ok) {
+        std::vector<uint8_t> encoded(7200);
+        int nwrite;
+        {
+            Timing::Scope scope(timing, Timing::encode);
+            nwrite = lame_encode_flush(encoder, encoded.data(), encoded.size());
+        }
+        if (nwrite < 0) {
+            logger.fatal("encoding flush failed. Code = : ", nwrite);
+            ok = false;
+        } else if (nwrite > 0) {
+            encoded.resize(nwrite);
+            ok = pipeline->mp3.push(std::move(encoded));
+        }
+    }
+
+    if (!ok) {
+        pipeline->failed = true;
+        pipeline->pcm.close();      //wakes the decoder up if it waits for space
+    }
+    pipeline->mp3.close();
+}
+
+void FLACtoMP3::writeStage() {
+    Trace::nameThread("pipeline writer");
+    while (std::optional<std::vector<uint8_t>> block = pipeline->mp3.pop()) {
+        if (!writeEncoded(block->data(), block->size())) {
+            logger.fatal("Error writing file ", outPath);
+            pipeline->failed = true;
+            pipeline->mp3.close();
+            pipeline->pcm.close();
+            return;
+        }
+        pipeline->freeMP3.tryPush(std::move(*block));
+    }
+}
+
+FLACtoMP3::Pipeline::Pipeline(std::size_t depth):
+    pcm(depth),
+    freePCM(depth),
+    mp3(depth),
+    freeMP3(depth),
+    failed(false),
+    encoder(),
+    writer()
+{}
+
+bool FLACtoMP3::writeEncoded(const uint8_t* data, uint32_t size) {
+    Timing::Scope scope(timing, Timing::write);
+    if (!segment.has_value())
+        return output.write(data, size);
+
+    pendingFrames.insert(pendingFrames.end(), data, data + size);
+    std::size_t offset = 0;
+    while (pendingFrames.size() - offset >= MP3Frame::headerSize) {
+        uint32_t length = MP3Frame::length(pendingFrames.data() + offset);
+        if (length == 0) {
+            logger.fatal("encoder produced something that is not an MP3 frame");
             return false;
         }
+        if (pendingFrames.size() - offset < length)
+            break;
+
+        if (frameIndex >= segment->keepFrom && (segment->keepTo == 0 || frameIndex < segment->keepTo)) {
+            if (!output.write(pendingFrames.data() + offset, length))
+                return false;
+
+            frameSizes.push_back(length);
+        }
+        ++frameIndex;
+        offset += length;
     }
+    pendingFrames.erase(pendingFrames.begin(), pendingFrames.begin() + offset);
+
+    return true;
 }
 
 void FLACtoMP3::metadata(const FLAC__StreamDecoder* decoder, const FLAC__StreamMetadata* metadata, void* client_data) {
     (void)(decoder);
     FLACtoMP3* self = static_cast<FLACtoMP3*>(client_data);
+    Timing::Scope scope(self->timing, metadata->type == FLAC__METADATA_TYPE_PICTURE ? Timing::picture : Timing::metadata);
 
     switch (metadata->type) {
         case FLAC__METADATA_TYPE_STREAMINFO:
             self->processInfo(metadata->data.stream_info);
             break;
         case FLAC__METADATA_TYPE_VORBIS_COMMENT:
+            Manifest::digestTags(self->tagDigest, *metadata);
             self->processTags(metadata->data.vorbis_comment);
             break;
         case FLAC__METADATA_TYPE_PICTURE:
+            Manifest::digestTags(self->tagDigest, *metadata);
             self->processPicture(metadata->data.picture);
             break;
+        case FLAC__METADATA_TYPE_SEEKTABLE:
+            self->processSeekTable(metadata->data.seek_table);
+            break;
         default:
             break;
     }
 }
 
+uint32_t FLACtoMP3::mp3Rate(uint32_t sampleRate) {
+    switch (sampleRate) {
+        case 8000:
+        case 11025:
+        case 12000:
+        case 16000:
+        case 22050:
+        case 24000:
+        case 32000:
+        case 44100:
+        case 48000:
+            return sampleRate;
+        default:
+            return sampleRate % 11025 == 0 ? 44100 : 48000;     //the whole ratios take the fewest phases
+    }
+}
+
 FLAC__StreamDecoderWriteStatus FLACtoMP3::write(
     const FLAC__StreamDecoder* decoder,
     const FLAC__Frame* frame,
@@ -382,17 +1004,15 @@ FLAC__StreamDecoderWriteStatus FLACtoMP3::write(
     //     return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
     // }
     FLACtoMP3* self = static_cast<FLACtoMP3*>(client_data);
-    if (frame->header.channels != 2) {
-        self->logger.fatal("ERROR: This frame contains " + std::to_string(frame->header.channels) + " channels (should be 2)");
-        return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
-    }
-    if (buffer[0] == NULL) {
-        self->logger.fatal("ERROR: buffer [0] is NULL");
+    if (frame->header.channels != self->converter.getChannels()) {
+        self->logger.fatal("ERROR: This frame contains ", frame->header.channels, " channels (should be ", self->converter.getChannels(), ")");
         return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
     }
-    if (buffer[1] == NULL) {
-        self->logger.fatal("ERROR: buffer [1] is NULL");
-        return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+    for (uint32_t channel = 0; channel < frame->header.channels; ++channel) {
+        if (buffer[channel] == NULL) {
+            self->logger.fatal("ERROR: buffer [", channel, "] is NULL");
+            return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+        }
     }
 
     bool result = self->decodeFrame(buffer, frame->header.blocksize);
@@ -407,7 +1027,45 @@ void FLACtoMP3::error(const FLAC__StreamDecoder* decoder, FLAC__StreamDecoderErr
     (void)decoder;
     FLACtoMP3* self = static_cast<FLACtoMP3*>(client_data);
     std::string errText(FLAC__StreamDecoderErrorStatusString[status]);
-    self->logger.error("Got error callback: " + errText);
+    self->logger.error("Got error callback: ", errText);
+}
+
+FLAC__StreamDecoderReadStatus FLACtoMP3::readInput(const FLAC__StreamDecoder* decoder, FLAC__byte buffer[], size_t* bytes, void* client_data) {
+    (void)(decoder);
+    FLACtoMP3* self = static_cast<FLACtoMP3*>(client_data);
+    *bytes = self->input.read(buffer, *bytes);
+    if (self->input.hasFailed()) {
+        self->logger.fatal("Error reading file ", self->inPath);
+        return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+    }
+
+    return *bytes > 0 ? FLAC__STREAM_DECODER_READ_STATUS_CONTINUE : FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+}
+
+FLAC__StreamDecoderSeekStatus FLACtoMP3::seekInput(const FLAC__StreamDecoder* decoder, FLAC__uint64 absolute_byte_offset, void* client_data) {
+    (void)(decoder);
+    FLACtoMP3* self = static_cast<FLACtoMP3*>(client_data);
+    return self->input.seek(absolute_byte_offset) ? FLAC__STREAM_DECODER_SEEK_STATUS_OK : FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+}
+
+FLAC__StreamDecoderTellStatus FLACtoMP3::tellInput(const FLAC__StreamDecoder* decoder, FLAC__uint64* absolute_byte_offset, void* client_data) {
+    (void)(decoder);
+    FLACtoMP3* self = static_cast<FLACtoMP3*>(client_data);
+    *absolute_byte_offset = self->input.tell();
+    return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+}
+
+FLAC__StreamDecoderLengthStatus FLACtoMP3::lengthInput(const FLAC__StreamDecoder* decoder, FLAC__uint64* stream_length, void* client_data) {
+    (void)(decoder);
+    FLACtoMP3* self = static_cast<FLACtoMP3*>(client_data);
+    *stream_length = self->input.length();
+    return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+}
+
+FLAC__bool FLACtoMP3::eofInput(const FLAC__StreamDecoder* decoder, void* client_data) {
+    (void)(decoder);
+    FLACtoMP3* self = static_cast<FLACtoMP3*>(client_data);
+    return self->input.eof();
 }
 
 void FLACtoMP3::attachPictureFrame(const FLAC__StreamMetadata_Picture& picture, const TagLib::ByteVector& bytes) {
@@ -511,14 +1169,30 @@ void FLACtoMP3::attachPictureFrame(const FLAC__StreamMetadata_Picture& picture,
     float KBytes = (float)sizeBytes / 1024;
     std::string strKBytes = std::to_string(KBytes);
     strKBytes = strKBytes.substr(0, strKBytes.find(".") + 3) + " KiB";
-    logger.info("attached picture size: " + strKBytes);
+    logger.info("attached picture size: ", strKBytes);
 
     std::string description = frame->description().to8Bit();
     if (description.size() > 0)
-        logger.info("attached picture has a description (b'cuz where else would you ever read it?): " + description);
-    id3v2tag.addFrame(frame);
+        logger.info("attached picture has a description (b'cuz where else would you ever read it?): ", description);
+    id3v2tag->addFrame(frame);
+}
+
+Timing::Samples FLACtoMP3::getTimings() const {
+    return timing.getSamples();
+}
+
+double FLACtoMP3::getDuration() const {
+    return sampleRate > 0 ? double(totalSamples) / sampleRate : 0;
+}
+
+Logger::History FLACtoMP3::takeHistory() {
+    return logger.takeHistory();
+}
+
+std::array<uint8_t, 16> FLACtoMP3::getStreamMD5() const {
+    return streamMD5;
 }
 
-std::list<Logger::Message> FLACtoMP3::getHistory() const {
-    return logger.getHistory();
+uint64_t FLACtoMP3::getTagDigest() const {
+    return tagDigest;
 }
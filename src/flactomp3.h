@@ -8,9 +8,22 @@
 #include <string>
 #include <string_view>
 #include <map>
+#include <list>
 #include <array>
+#include <vector>
+#include <optional>
+#include <memory>
+#include <thread>
+#include <atomic>
 #include <stdio.h>
 
+#include "spscring.h"
+#include "pcmconverter.h"
+#include "resampler.h"
+#include "inputreader.h"
+#include "outputwriter.h"
+#include "timing.h"
+#include "manifest.h"
 #include "logger/accumulator.h"
 
 class FLACtoMP3 {
@@ -21,21 +34,70 @@ public:
     void setInputFile(const std::string& path);
     void setOutputFile(const std::string& path);
     void setParameters(unsigned char encodingQuality, unsigned char outputQuality, bool vbr);
+    void setSegmentation(uint32_t splitLongerThan, unsigned int maxSegments);
+    void setPipelined(bool pipelined);
+    void setResampling(uint32_t outputRate, bool polyphase);
     bool run();
+    void reset();
 
-    std::list<Logger::Message> getHistory() const;
+    Logger::History takeHistory();
+    std::array<uint8_t, 16> getStreamMD5() const;
+    uint64_t getTagDigest() const;      //of the tags and pictures that went to the output, as Manifest::identify makes it
+    Timing::Samples getTimings() const;
+    double getDuration() const;
 
 private:
+    struct Segment {
+        uint64_t from;          //first sample given to the encoder
+        uint64_t to;            //sample after the last one given to the encoder, 0 for the end of the stream
+        uint64_t keepFrom;      //first encoded frame that makes it to the output
+        uint64_t keepTo;        //frame after the last one that makes it to the output, 0 for all the rest
+        bool first;
+    };
+
+    struct Pipeline {
+        Pipeline(std::size_t depth);
+
+        SPSCRing<std::vector<float>> pcm;           //decoder to encoder, planar, the right channel starts in the middle
+        SPSCRing<std::vector<float>> freePCM;       //encoded blocks go back to the decoder to be filled again
+        SPSCRing<std::vector<uint8_t>> mp3;         //encoder to writer
+        SPSCRing<std::vector<uint8_t>> freeMP3;
+        std::atomic<bool> failed;
+        std::thread encoder;
+        std::thread writer;
+    };
+
     void processTags(const FLAC__StreamMetadata_VorbisComment& tags);
     void processInfo(const FLAC__StreamMetadata_StreamInfo& info);
     void processPicture(const FLAC__StreamMetadata_Picture& picture);
+    void processSeekTable(const FLAC__StreamMetadata_SeekTable& table);
     bool decodeFrame(const int32_t * const buffer[], uint32_t size);
+    bool resample();
     bool flush();
+    bool finish(bool ok);
+    bool writeEncoded(const uint8_t* data, uint32_t size);
     bool initializeOutput();
+    bool releaseOutput(bool keep);
+    uint64_t estimateSize() const;
+    std::vector<Segment> planSegments(uint32_t frameSize) const;
+    std::string segmentPath(std::size_t index) const;
+    bool runSegmented();
+    bool encodeSegment();
+    bool stitch(std::vector<std::unique_ptr<FLACtoMP3>>& parts);
+    void startPipeline();
+    bool stopPipeline();
+    void encodeStage();
+    void writeStage();
     bool scaleJPEG(const FLAC__StreamMetadata_Picture& picture);
     void attachPictureFrame(const FLAC__StreamMetadata_Picture& picture, const TagLib::ByteVector& bytes);
 
+    static uint32_t mp3Rate(uint32_t sampleRate);
     static void error(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data);
+    static FLAC__StreamDecoderReadStatus readInput(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
+    static FLAC__StreamDecoderSeekStatus seekInput(const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data);
+    static FLAC__StreamDecoderTellStatus tellInput(const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data);
+    static FLAC__StreamDecoderLengthStatus lengthInput(const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data);
+    static FLAC__bool eofInput(const FLAC__StreamDecoder *decoder, void *client_data);
     static void metadata(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data);
     static FLAC__StreamDecoderWriteStatus write(
         const FLAC__StreamDecoder *decoder,
@@ -48,20 +110,50 @@ private:
     Accumulator logger;
     std::string inPath;
     std::string outPath;
+    std::string tempPath;       //the output is written here and takes its place only when it's complete
 
     FLAC__StreamDecoder *decoder;
     lame_t encoder;
     FLAC__StreamDecoderInitStatus statusFLAC;
+    InputReader input;
 
-    FILE* output;
+    OutputWriter output;
+    uint64_t tagPosition;       //where the Xing frame goes, right after the ID3v2 tag
     uint8_t bufferMultiplier;
     uint32_t flacMaxBlockSize;
-    uint32_t pcmCounter;
-    uint32_t pcmSize;
-    int16_t* pcm;
+    uint32_t pcmCounter;        //frames in the buffer
+    uint32_t pcmSize;           //frames the buffer holds
+    std::vector<float> pcm;     //the left channel, then the right one from pcmSize on
+    PCMConverter converter;
     uint8_t* outputBuffer;
-    uint32_t outputBufferSize;
+    uint32_t outputBufferSize;  //stays allocated between files, it only grows
     bool outputInitilized;
     bool downscaleAlbumArt;
-    TagLib::ID3v2::Tag id3v2tag;
+    std::array<uint8_t, 16> streamMD5;
+    uint64_t tagDigest;
+    std::unique_ptr<TagLib::ID3v2::Tag> id3v2tag;
+
+    unsigned char encodingQuality;
+    unsigned char outputQuality;
+    bool vbr;
+    uint32_t splitLongerThan;           //seconds, 0 means never split
+    unsigned int maxSegments;
+    uint32_t sampleRate;
+    uint64_t totalSamples;
+    std::vector<uint64_t> seekPoints;
+    uint32_t outputRate;                //0 keeps the rate if MP3 has it
+    bool polyphase;                     //resampling by the resampler, not by LAME
+    Resampler resampler;
+
+    std::optional<Segment> segment;     //only the convertors that encode a part of someone else's file have it
+    uint64_t decodedSamples;
+    bool segmentComplete;
+    uint64_t frameIndex;
+    std::vector<uint8_t> pendingFrames;
+    std::vector<uint32_t> frameSizes;
+    std::vector<uint8_t> lameTag;
+
+    bool pipelined;
+    std::unique_ptr<Pipeline> pipeline;
+    Timing timing;
 };
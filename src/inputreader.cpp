@@ -0,0 +1,158 @@
+#include "inputreader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+InputReader::InputReader(std::size_t blockSize):
+    blockSize(blockSize),
+    file(-1),
+    size(0),
+    position(0),
+    buffer(),
+    bufferPosition(0),
+    failed(false),
+    ring(),
+    ahead(),
+    aheadPosition(0),
+    aheadPending(false)
+{}
+
+InputReader::~InputReader() {
+    close();
+}
+
+bool InputReader::open(const std::string& path) {
+    close();
+    file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file == -1)
+        return false;
+
+    struct stat info;
+    if (::fstat(file, &info) == -1) {
+        close();
+        return false;
+    }
+
+    size = info.st_size;
+    ::posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);     //only a hint, nothing to do if it's not taken
+    buffer.reserve(blockSize);
+    if (!ring)
+        ring = IORing::create(2);
+
+    return true;
+}
+
+void InputReader::close() {
+    if (aheadPending)
+        ring->wait();       //the kernel might still be writing to the buffer
+
+    aheadPending = false;
+    ahead.clear();          //the capacity is kept for the next file
+    if (file != -1)
+        ::close(file);
+
+    file = -1;
+    size = 0;
+    position = 0;
+    buffer.clear();
+    bufferPosition = 0;
+    failed = false;
+}
+
+std::size_t InputReader::read(uint8_t* data, std::size_t size) {
+    std::size_t done = 0;
+    while (done < size) {
+        if (position < bufferPosition || position >= bufferPosition + buffer.size()) {
+            if (!fill())
+                break;
+        }
+
+        std::size_t offset = position - bufferPosition;
+        std::size_t chunk = std::min(size - done, buffer.size() - offset);
+        std::copy(buffer.begin() + offset, buffer.begin() + offset + chunk, data + done);
+        done += chunk;
+        position += chunk;
+    }
+
+    return done;
+}
+
+bool InputReader::seek(uint64_t position) {
+    if (file == -1 || position > size)
+        return false;
+
+    InputReader::position = position;      //the buffer is refilled only if the position is outside of it
+    return true;
+}
+
+uint64_t InputReader::tell() const {
+    return position;
+}
+
+uint64_t InputReader::length() const {
+    return size;
+}
+
+bool InputReader::eof() const {
+    return file == -1 || position >= size;
+}
+
+bool InputReader::hasFailed() const {
+    return failed;
+}
+
+void InputReader::prefetch(const std::string& path) {
+    int prefetched = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (prefetched == -1)
+        return;
+
+    ::posix_fadvise(prefetched, 0, 0, POSIX_FADV_WILLNEED);       //the kernel reads in the background, the pages stay after closing
+    ::close(prefetched);
+}
+
+bool InputReader::fill() {
+    if (file == -1 || failed || position >= size)
+        return false;
+
+    ssize_t count = -1;
+    if (aheadPending) {
+        std::optional<IORing::Completion> done = ring->wait();
+        aheadPending = false;
+        if (done.has_value() && done->result > 0 && aheadPosition == position) {
+            buffer.swap(ahead);
+            count = done->result;
+        }
+    }
+
+    if (count == -1) {      //seeked away from what was read ahead, or it didn't work, the usual way reports why
+        buffer.resize(blockSize);
+        do {
+            count = ::pread(file, buffer.data(), blockSize, position);
+        } while (count == -1 && errno == EINTR);
+    }
+
+    if (count <= 0) {
+        failed = true;      //nothing to read before the size fstat said, the file got truncated under us
+        buffer.clear();
+        return false;
+    }
+
+    buffer.resize(count);
+    bufferPosition = position;
+    readAhead();
+    return true;
+}
+
+void InputReader::readAhead() {
+    uint64_t next = bufferPosition + buffer.size();
+    if (!ring || next >= size)
+        return;
+
+    ahead.resize(blockSize);
+    aheadPosition = next;
+    aheadPending = ring->read(file, ahead.data(), blockSize, next, 0);
+    ring->submit();
+}
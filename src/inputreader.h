@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "ioring.h"
+
+//Reads the source file for libFLAC in large blocks instead of the small stdio reads it does on its own.
+//The kernel is told the file is read from the start to the end, so it reads ahead in larger chunks.
+//With io_uring the next block is being read while the current one is decoded.
+//Any other file can be asked to be read into the page cache in advance, before it's opened for decoding
+class InputReader {
+public:
+    static constexpr std::size_t defaultBlockSize = 1024 * 1024;
+
+    InputReader(std::size_t blockSize = defaultBlockSize);
+    ~InputReader();
+
+    bool open(const std::string& path);
+    void close();
+    std::size_t read(uint8_t* data, std::size_t size);
+    bool seek(uint64_t position);
+
+    uint64_t tell() const;
+    uint64_t length() const;
+    bool eof() const;
+    bool hasFailed() const;
+
+    static void prefetch(const std::string& path);
+
+private:
+    bool fill();
+    void readAhead();
+
+private:
+    const std::size_t blockSize;
+    int file;
+    uint64_t size;
+    uint64_t position;
+    std::vector<uint8_t> buffer;
+    uint64_t bufferPosition;        //where in the file the buffer starts
+    bool failed;
+    std::unique_ptr<IORing> ring;
+    std::vector<uint8_t> ahead;     //the block after the buffer, the kernel fills it in the background
+    uint64_t aheadPosition;
+    bool aheadPending;
+};
@@ -0,0 +1,260 @@
+#include "ioring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+constexpr unsigned int threadRingEntries = 32;
+
+namespace {
+    std::atomic<bool> enabled(false);
+    std::atomic<bool> directories(false);   //IORING_OP_MKDIRAT came in 5.15, much later than reads and writes in 5.6
+
+    int setupRing(unsigned int entries, io_uring_params* params) {
+        return syscall(__NR_io_uring_setup, entries, params);
+    }
+
+    int enterRing(int ring, unsigned int submit, unsigned int wait, unsigned int flags) {
+        return syscall(__NR_io_uring_enter, ring, submit, wait, flags, nullptr, 0);
+    }
+
+    int registerRing(int ring, unsigned int opcode, void* argument, unsigned int count) {
+        return syscall(__NR_io_uring_register, ring, opcode, argument, count);
+    }
+}
+
+IORing::IORing():
+    ring(-1),
+    sqRing(MAP_FAILED),
+    cqRing(MAP_FAILED),
+    sqRingSize(0),
+    cqRingSize(0),
+    sqes(nullptr),
+    sqesSize(0),
+    sqTail(nullptr),
+    sqHead(nullptr),
+    sqArray(nullptr),
+    sqMask(0),
+    sqEntries(0),
+    cqHead(nullptr),
+    cqTail(nullptr),
+    cqMask(0),
+    cqes(nullptr),
+    queued(0),
+    pending(0)
+{}
+
+IORing::~IORing() {
+    while (pending > 0 && wait().has_value());      //the kernel must not write to buffers their owners are about to free
+
+    unmap();
+    if (ring != -1)
+        ::close(ring);
+}
+
+bool IORing::setup(unsigned int entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring = setupRing(entries, &params);
+    if (ring == -1)
+        return false;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single)
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+    sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    if (sqRing != MAP_FAILED)
+        cqRing = single ? sqRing : ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* entriesMap = MAP_FAILED;
+    if (cqRing != MAP_FAILED)
+        entriesMap = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+
+    if (entriesMap == MAP_FAILED) {
+        unmap();
+        ::close(ring);
+        ring = -1;
+        return false;
+    }
+
+    uint8_t* sq = static_cast<uint8_t*>(sqRing);
+    uint8_t* cq = static_cast<uint8_t*>(cqRing);
+    sqes = static_cast<io_uring_sqe*>(entriesMap);
+    sqHead = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+    sqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+    sqMask = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    cqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+bool IORing::read(int file, void* data, uint32_t size, uint64_t offset, uint64_t tag) {
+    io_uring_sqe* sqe = next(tag);
+    if (sqe == nullptr)
+        return false;
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = file;
+    sqe->addr = reinterpret_cast<uint64_t>(data);
+    sqe->len = size;
+    sqe->off = offset;
+    return true;
+}
+
+bool IORing::write(int file, const void* data, uint32_t size, uint64_t offset, uint64_t tag) {
+    io_uring_sqe* sqe = next(tag);
+    if (sqe == nullptr)
+        return false;
+
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = file;
+    sqe->addr = reinterpret_cast<uint64_t>(data);
+    sqe->len = size;
+    sqe->off = offset;
+    return true;
+}
+
+bool IORing::mkdir(const char* path, mode_t mode, uint64_t tag) {
+    if (!directories)
+        return false;
+
+    io_uring_sqe* sqe = next(tag);
+    if (sqe == nullptr)
+        return false;
+
+    sqe->opcode = IORING_OP_MKDIRAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uint64_t>(path);
+    sqe->len = mode;
+    return true;
+}
+
+bool IORing::submit() {
+    return queued == 0 || enter(queued, 0);
+}
+
+std::optional<IORing::Completion> IORing::wait() {
+    while (true) {
+        unsigned int head = *cqHead;
+        if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            Completion completion = {cqe.user_data, cqe.res};
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+            --pending;
+            return completion;
+        }
+
+        if (pending == 0 || !enter(queued, 1))
+            return std::nullopt;
+    }
+}
+
+unsigned int IORing::inFlight() const {
+    return pending;
+}
+
+bool IORing::enable() {
+    IORing probe;
+    if (!probe.setup(1) || !probe.supports(IORING_OP_READ) || !probe.supports(IORING_OP_WRITE))
+        return false;
+
+    directories = probe.supports(IORING_OP_MKDIRAT);
+    enabled = true;
+    return true;
+}
+
+bool IORing::isUnsupported(int32_t result) {
+    return result == -EINVAL || result == -EOPNOTSUPP;     //an older kernel that doesn't know the request or a filesystem that can't do it
+}
+
+std::unique_ptr<IORing> IORing::create(unsigned int entries) {
+    if (!enabled)
+        return nullptr;
+
+    std::unique_ptr<IORing> result = std::make_unique<IORing>();
+    if (!result->setup(entries))
+        return nullptr;
+
+    return result;
+}
+
+IORing* IORing::forThread() {
+    thread_local std::unique_ptr<IORing> local = create(threadRingEntries);
+    return local.get();
+}
+
+bool IORing::supports(uint8_t operation) const {
+    std::vector<uint8_t> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+    if (registerRing(ring, IORING_REGISTER_PROBE, probe, 256) < 0)      //there is no probing before 5.6, there are no reads either
+        return false;
+
+    return operation <= probe->last_op && (probe->ops[operation].flags & IO_URING_OP_SUPPORTED);
+}
+
+io_uring_sqe* IORing::next(uint64_t tag) {
+    if (ring == -1)
+        return nullptr;
+
+    unsigned int tail = *sqTail;
+    if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+        if (!enter(queued, 0))
+            return nullptr;
+
+        tail = *sqTail;
+    }
+
+    unsigned int index = tail & sqMask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    sqe->user_data = tag;
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    ++queued;
+    ++pending;
+    return sqe;
+}
+
+bool IORing::enter(unsigned int submit, unsigned int wait) {
+    while (true) {
+        int submitted = enterRing(ring, submit, wait, wait > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (submitted >= 0) {
+            queued -= std::min<unsigned int>(submitted, queued);
+            return true;
+        }
+
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            return false;
+    }
+}
+
+void IORing::unmap() {
+    if (sqes != nullptr)
+        ::munmap(sqes, sqesSize);
+
+    if (cqRing != MAP_FAILED && cqRing != sqRing)
+        ::munmap(cqRing, cqRingSize);
+
+    if (sqRing != MAP_FAILED)
+        ::munmap(sqRing, sqRingSize);
+
+    sqes = nullptr;
+    sqRing = MAP_FAILED;
+    cqRing = MAP_FAILED;
+}
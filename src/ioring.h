@@ -0,0 +1,67 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+//A small io_uring made with the raw system calls, so there is no liburing to depend on.
+//Requests are queued with read, write and mkdir and go to the kernel together,
+//in one io_uring_enter, when wait is called or when the submission queue is full.
+//A ring belongs to one thread at a time, it has no locks.
+//It's off unless enabled, everyone who uses it keeps the blocking way for when there is no ring
+//or the kernel turns a request down as one it doesn't know
+class IORing {
+public:
+    struct Completion {
+        uint64_t tag;
+        int32_t result;         //what the system call would return, or -errno
+    };
+
+    IORing();
+    ~IORing();
+
+    bool setup(unsigned int entries);
+    bool read(int file, void* data, uint32_t size, uint64_t offset, uint64_t tag);
+    bool write(int file, const void* data, uint32_t size, uint64_t offset, uint64_t tag);
+    bool mkdir(const char* path, mode_t mode, uint64_t tag);
+    bool submit();
+    std::optional<Completion> wait();
+
+    unsigned int inFlight() const;
+
+    static bool enable();
+    static bool isUnsupported(int32_t result);
+    static std::unique_ptr<IORing> create(unsigned int entries);
+    static IORing* forThread();
+
+private:
+    bool supports(uint8_t operation) const;
+    io_uring_sqe* next(uint64_t tag);
+    bool enter(unsigned int submit, unsigned int wait);
+    void unmap();
+
+private:
+    int ring;
+    void* sqRing;
+    void* cqRing;
+    std::size_t sqRingSize;
+    std::size_t cqRingSize;
+    io_uring_sqe* sqes;
+    std::size_t sqesSize;
+    unsigned int* sqTail;
+    unsigned int* sqHead;
+    unsigned int* sqArray;
+    unsigned int sqMask;
+    unsigned int sqEntries;
+    unsigned int* cqHead;
+    unsigned int* cqTail;
+    unsigned int cqMask;
+    io_uring_cqe* cqes;
+    unsigned int queued;        //prepared but not given to the kernel yet
+    unsigned int pending;       //prepared and not completed yet
+};
@@ -0,0 +1,29 @@
+#include "job.h"
+
+Job::Job(
+    Type type,
+    const std::shared_ptr<const Directory>& directory,
+    const std::string& name,
+    const std::string& output,
+    const Manifest::Entry& entry
+):
+    type(type),
+    directory(directory),
+    name(name),
+    output(output),
+    size(entry.size),
+    mtime(entry.mtime),
+    md5(entry.md5),
+    tags(entry.tags),
+    cost(0),
+    footprint(0),
+    queued(0),
+    duration(0) {}
+
+std::filesystem::path Job::source() const {
+    return directory->source() / name;
+}
+
+std::filesystem::path Job::destination() const {
+    return directory->destination() / output;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <filesystem>
+
+#include "directory.h"
+#include "manifest.h"
+
+struct Job {
+    enum Type {
+        copy,
+        convert
+    };
+    Job(Type type, const std::shared_ptr<const Directory>& directory, const std::string& name, const std::string& output, const Manifest::Entry& entry);
+
+    std::filesystem::path source() const;
+    std::filesystem::path destination() const;
+
+    Type type;
+    std::shared_ptr<const Directory> directory;
+    std::string name;
+    std::string output;
+    uint64_t size;
+    int64_t mtime;
+    Manifest::MD5 md5;
+    uint64_t tags;          //digest of the tags that went to the output, set by the conversion
+    uint64_t cost;          //estimated work, channel milliseconds weighted by the sample rate, only the order of jobs depends on it
+    uint64_t footprint;     //estimated memory in bytes the job needs while it runs
+    uint64_t queued;        //monotonic nanoseconds when the job was queued
+    double duration;        //seconds of audio from STREAMINFO, exact after the conversion
+};
@@ -1,9 +1,16 @@
 #include "accumulator.h"
 
+#include <iterator>
+
+constexpr std::size_t expectedMessages = 16;     //a conversion rarely says more, so it doesn't reallocate
+
 Accumulator::Accumulator(Severity severity):
     severity(severity),
+    mutex(),
     history()
-{}
+{
+    history.reserve(expectedMessages);
+}
 
 Logger::Severity Accumulator::getSeverity() const {
     return severity;
@@ -13,21 +20,33 @@ void Accumulator::setSeverity(Severity severity) {
     Accumulator::severity = severity;
 }
 
-void Accumulator::log(const std::list<Message>& comments, bool colored) const {
+void Accumulator::log(const History& comments, bool colored) const {
     (void)(colored);
+    std::lock_guard lock(mutex);
     for (const Message& comment : comments)
         if (comment.first >= Accumulator::severity)
             history.emplace_back(comment);
 }
 
-void Accumulator::log(Severity severity, const std::string& comment, bool colored) const {
+void Accumulator::log(Severity severity, std::string comment, bool colored) const {
     (void)(colored);
     if (severity < Accumulator::severity)
         return;
 
-    history.emplace_back(severity, comment);
+    std::lock_guard lock(mutex);
+    history.emplace_back(severity, std::move(comment));
+}
+
+void Accumulator::append(History&& comments) {
+    std::lock_guard lock(mutex);
+    for (Message& comment : comments)
+        if (comment.first >= severity)
+            history.emplace_back(std::move(comment));
 }
 
-std::list<Logger::Message> Accumulator::getHistory() const {
-    return history;
+Logger::History Accumulator::takeHistory() {
+    std::lock_guard lock(mutex);
+    History result(std::make_move_iterator(history.begin()), std::make_move_iterator(history.end()));  //right-sized, the reserved capacity stays for the next file
+    history.clear();
+    return result;
 }
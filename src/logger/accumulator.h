@@ -1,20 +1,24 @@
 #pragma once
 
+#include <mutex>
+
 #include "logger.h"
 
 class Accumulator : public Logger {
 public:
     Accumulator(Severity severity = Severity::info);
 
-    virtual void log(const std::list<Message>& comments, bool colored = true) const override;
-    virtual void log(Severity severity, const std::string& comment, bool colored = true) const override;
+    virtual void log(const History& comments, bool colored = true) const override;
+    virtual void log(Severity severity, std::string comment, bool colored = true) const override;
 
     virtual Severity getSeverity() const override;
     virtual void setSeverity(Severity severity) override;
 
-    std::list<Message> getHistory() const;
+    void append(History&& comments);
+    History takeHistory();
 
 private:
     Severity severity;
-    mutable std::list<Message> history;
+    mutable std::mutex mutex;       //the stages of a pipelined conversion report from their own threads
+    mutable History history;
 };
@@ -16,32 +16,8 @@ constexpr std::array<std::string_view, static_cast<int>(Logger::Severity::_sever
 
 Logger::~Logger() {}
 
-void Logger::debug(const std::string& comment, bool colored) const {
-    log(Severity::debug, comment, colored);
-}
-
-void Logger::info(const std::string& comment, bool colored) const {
-    log(Severity::info, comment, colored);
-}
-
-void Logger::minor(const std::string& comment, bool colored) const {
-    log(Severity::minor, comment, colored);
-}
-
-void Logger::major(const std::string& comment, bool colored) const {
-    log(Severity::major, comment, colored);
-}
-
-void Logger::warn(const std::string& comment, bool colored) const {
-    log(Severity::warning, comment, colored);
-}
-
-void Logger::error(const std::string& comment, bool colored) const {
-    log(Severity::error, comment, colored);
-}
-
-void Logger::fatal(const std::string& comment, bool colored) const {
-    log(Severity::fatal, comment, colored);
+bool Logger::isEnabled(Severity severity) const {
+    return severity >= compiledSeverity && severity >= getSeverity();
 }
 
 Logger::Severity Logger::stringToSeverity(const std::string& line) {
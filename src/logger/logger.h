@@ -1,7 +1,10 @@
 #pragma once
 
-#include <list>
+#include <vector>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <type_traits>
 
 class Logger {
 public:
@@ -16,21 +19,95 @@ public:
         _severitySize 
     };
     using Message = std::pair<Severity, std::string>;
+    using History = std::vector<Message>;
 
-    void debug(const std::string& comment, bool colored = true) const;
-    void info(const std::string& comment, bool colored = true) const;
-    void minor(const std::string& comment, bool colored = true) const;
-    void major(const std::string& comment, bool colored = true) const;
-    void warn(const std::string& comment, bool colored = true) const;
-    void error(const std::string& comment, bool colored = true) const;
-    void fatal(const std::string& comment, bool colored = true) const;
+#ifdef MLC_NO_DEBUG_LOGS
+    static constexpr Severity compiledSeverity = Severity::info;     //anything less is not even compiled in
+#else
+    static constexpr Severity compiledSeverity = Severity::debug;
+#endif
+
+    //The parts are only formatted if the message is going to be kept
+    template <typename... Parts> void debug(const Parts&... parts) const;
+    template <typename... Parts> void info(const Parts&... parts) const;
+    template <typename... Parts> void minor(const Parts&... parts) const;
+    template <typename... Parts> void major(const Parts&... parts) const;
+    template <typename... Parts> void warn(const Parts&... parts) const;
+    template <typename... Parts> void error(const Parts&... parts) const;
+    template <typename... Parts> void fatal(const Parts&... parts) const;
 
     virtual ~Logger();
-    virtual void log(const std::list<Message>& comments, bool colored = true) const = 0;
-    virtual void log(Severity severity, const std::string& comment, bool colored = true) const = 0;
+    virtual void log(const History& comments, bool colored = true) const = 0;
+    virtual void log(Severity severity, std::string comment, bool colored = true) const = 0;
 
     virtual void setSeverity(Severity severity) = 0;
     virtual Severity getSeverity() const = 0;
 
+    bool isEnabled(Severity severity) const;
+
     static Severity stringToSeverity(const std::string& line);
+
+private:
+    template <Severity severity, typename... Parts> void write(const Parts&... parts) const;
+    template <typename Part> static void append(std::string& message, const Part& part);
 };
+
+template <typename... Parts>
+void Logger::debug(const Parts&... parts) const {
+    write<Severity::debug>(parts...);
+}
+
+template <typename... Parts>
+void Logger::info(const Parts&... parts) const {
+    write<Severity::info>(parts...);
+}
+
+template <typename... Parts>
+void Logger::minor(const Parts&... parts) const {
+    write<Severity::minor>(parts...);
+}
+
+template <typename... Parts>
+void Logger::major(const Parts&... parts) const {
+    write<Severity::major>(parts...);
+}
+
+template <typename... Parts>
+void Logger::warn(const Parts&... parts) const {
+    write<Severity::warning>(parts...);
+}
+
+template <typename... Parts>
+void Logger::error(const Parts&... parts) const {
+    write<Severity::error>(parts...);
+}
+
+template <typename... Parts>
+void Logger::fatal(const Parts&... parts) const {
+    write<Severity::fatal>(parts...);
+}
+
+template <Logger::Severity severity, typename... Parts>
+void Logger::write(const Parts&... parts) const {
+    if constexpr (severity >= compiledSeverity) {
+        if (!isEnabled(severity))
+            return;
+
+        std::string message;
+        (append(message, parts), ...);
+        log(severity, std::move(message));
+    }
+}
+
+template <typename Part>
+void Logger::append(std::string& message, const Part& part) {
+    if constexpr (std::is_integral_v<Part> && !std::is_same_v<Part, char> && !std::is_same_v<Part, bool>) {
+        char buffer[24];
+        std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), part);
+        message.append(buffer, result.ptr);
+    } else if constexpr (std::is_floating_point_v<Part>) {
+        message += std::to_string(part);
+    } else {
+        message += part;
+    }
+}
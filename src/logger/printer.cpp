@@ -3,6 +3,7 @@
 #include <array>
 #include <string_view>
 #include <iostream>
+#include <algorithm>
 
 constexpr const std::array<std::string_view, static_cast<int>(Logger::Severity::_severitySize)> logSettings({
     /*debug*/   "\e[90m",
@@ -29,12 +30,40 @@ constexpr const std::string_view regular("\e[22m");
 constexpr const std::string_view clearStyle("\e[0m");
 constexpr const std::string_view clearLine("\e[2K\r");
 
+constexpr std::size_t ringSize = 4096;
+constexpr std::chrono::milliseconds statusInterval(100);
+
 Printer::Printer(Severity severity):
     severity(severity),
-    mutex(),
-    status(std::nullopt)
+    records(ringSize),
+    pushed(0),
+    printed(0),
+    spaceMutex(),
+    spaceConditional(),
+    parked(0),
+    status(),
+    statusChanged(false),
+    sinkMutex(),
+    sinkConditional(),
+    flushConditional(),
+    running(true),
+    wake(false),
+    force(false),
+    statusShown(false),
+    lastRedraw(),
+    thread(&Printer::sink, this)
 {}
 
+Printer::~Printer() {
+    {
+        std::lock_guard lock(sinkMutex);
+        running = false;
+        wake = true;
+    }
+    sinkConditional.notify_one();
+    thread.join();
+}
+
 Logger::Severity Printer::getSeverity() const {
     return severity;
 }
@@ -44,86 +73,151 @@ void Printer::setSeverity(Severity severity) {
 }
 
 void Printer::setStatusMessage(const std::string& message) {
-    if (status.has_value())
-        std::cout << clearLine;
-
-    status = message;
-    std::cout << message << std::flush;
+    std::atomic_store(&status, std::make_shared<const std::string>(message));
+    statusChanged = true;       //after the store, so the sink that sees the flag also sees the message
 }
 
 void Printer::clearStatusMessage() {
-    if (status.has_value()) {
-        std::cout << clearLine << std::flush;
-        status = std::nullopt;
-    }
+    if (!std::atomic_exchange(&status, std::shared_ptr<const std::string>()))
+        return;
+
+    statusChanged = true;
+    flush();
 }
 
 void Printer::printNested(
     const std::string& header,
     const std::vector<std::string>& lines,
-    const std::list<Message>& comments,
+    History comments,
     const std::optional<std::string>& status
 ) {
-    std::lock_guard lock(mutex);
     if (comments.size() > 0) {
-        if (status.has_value())
-            std::cout << clearLine;
-
-        std::cout << bold << header << clearStyle << "\n";
-        for (const std::string& line : lines)
-            std::cout << line << "\n";
-
-        for (const Message& msg : comments) {
-            if (msg.first >= severity) {
-                std::cout << '\t';
-                printMessage(msg, true);
-            }
-        }
+        Severity level = severity;
+        comments.erase(std::remove_if(comments.begin(), comments.end(), [level] (const Message& msg) {
+            return msg.first < level;
+        }), comments.end());
+        push({header, lines, std::move(comments), true});
     }
 
     if (status.has_value())
-        Printer::status = status;
+        setStatusMessage(status.value());
+}
+
+void Printer::log(const History& comments, bool colored) const {
+    Record record{std::nullopt, {}, {}, colored};
+    for (const Message& msg : comments)
+        if (msg.first >= severity)
+            record.comments.push_back(msg);
+
+    if (!record.comments.empty())
+        push(std::move(record));
+}
 
-    finishPrint(true);
+void Printer::log(Severity severity, std::string comment, bool colored) const {
+    if (severity < Printer::severity)
+        return;
+
+    push({std::nullopt, {}, {{severity, std::move(comment)}}, colored});
 }
 
-void Printer::log(const std::list<Message>& comments, bool colored) const {
-    std::lock_guard lock(mutex);
+void Printer::flush() {
+    uint64_t target = pushed;
+    std::unique_lock lock(sinkMutex);
+    if (!running)
+        return;
 
-    bool changed = false;
-    for (const Message& msg : comments) {
-        if (msg.first >= severity) {
-            if (!changed && status.has_value())
-                std::cout << clearLine;
+    wake = true;
+    force = true;
+    sinkConditional.notify_one();
+    flushConditional.wait(lock, [this, target] () {
+        return printed >= target && !force;
+    });
+}
 
-            printMessage(msg, colored);
-            changed = true;
+void Printer::push(Record&& record) const {
+    if (!records.push(std::move(record))) {         //full, the record is still ours, the sink has to catch up
+        std::unique_lock lock(spaceMutex);
+        ++parked;       //before trying again, so the sink that empties the ring after it wakes this thread
+        while (!records.push(std::move(record))) {
+            wake = true;
+            sinkConditional.notify_one();
+            spaceConditional.wait_for(lock, statusInterval);
         }
+        --parked;
     }
+    ++pushed;
+}
+
+void Printer::sink() {
+    std::unique_lock lock(sinkMutex);
+    while (true) {
+        bool printedAny = false;
+        while (std::optional<Record> record = records.pop()) {
+            if (!printedAny && statusShown)
+                std::cout << clearLine;
+
+            printRecord(record.value());
+            printedAny = true;
+            ++printed;
+        }
+        if (parked > 0) {
+            std::lock_guard space(spaceMutex);
+            spaceConditional.notify_all();
+        }
 
-    finishPrint(colored);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (printedAny || force || now - lastRedraw >= statusInterval) {
+            redrawStatus(printedAny);
+            lastRedraw = now;
+        }
+
+        if (printedAny || force) {
+            force = false;
+            flushConditional.notify_all();
+        }
+
+        if (!running)
+            return;
+
+        wake = false;
+        sinkConditional.wait_for(lock, statusInterval, [this] () {
+            return wake.load();
+        });
+    }
 }
 
-void Printer::log(Severity severity, const std::string& comment, bool colored) const {
-    if (severity < Printer::severity)
+void Printer::redrawStatus(bool lineCleared) {
+    bool changed = statusChanged.exchange(false);       //before the load, a message stored after it raises the flag again
+    if (!lineCleared && !changed)
         return;
 
-    std::lock_guard lock(mutex);
-    if (status.has_value())
+    std::shared_ptr<const std::string> current = std::atomic_load(&status);
+    if (statusShown && !lineCleared)
         std::cout << clearLine;
 
-    printMessage({severity, comment}, colored);
-    finishPrint(colored);
+    if (current)
+        std::cout << *current;
+
+    statusShown = static_cast<bool>(current);
+    std::cout << std::flush;
 }
 
-void Printer::finishPrint(bool colored) const {
-    if (colored)
-        std::cout << clearStyle;
+void Printer::printRecord(const Record& record) const {
+    if (record.header.has_value()) {
+        std::cout << bold << record.header.value() << clearStyle << "\n";
+        for (const std::string& line : record.lines)
+            std::cout << line << "\n";
+    }
 
-    if (status.has_value())
-        std::cout << '\r' << status.value();
+    for (const Message& msg : record.comments) {
+        if (record.header.has_value())
+            std::cout << '\t';
 
-    std::cout << std::flush;
+        printMessage(msg, record.colored);
+    }
+
+    if (record.colored)
+        std::cout << clearStyle;
 }
 
 void Printer::printMessage(const Message& message, bool colored) const {
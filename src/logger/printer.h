@@ -2,18 +2,27 @@
 
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
 #include <string>
+#include <memory>
 #include <optional>
 #include <vector>
 
 #include "logger.h"
+#include "../ring.h"
 
+//Callers only put their messages to a lock-free ring, the terminal is written by one sink thread.
+//If the ring is full they sleep until the sink has emptied it.
+//The status line is redrawn right after the messages, or on its own not more often than statusInterval
 class Printer : public Logger {
 public:
     Printer(Severity severity = Severity::info);
+    ~Printer();
 
-    virtual void log(const std::list<Message>& comments, bool colored = true) const override;
-    virtual void log(Severity severity, const std::string& comment, bool colored = true) const override;
+    virtual void log(const History& comments, bool colored = true) const override;
+    virtual void log(Severity severity, std::string comment, bool colored = true) const override;
 
     virtual void setSeverity(Severity severity) override;
     virtual Severity getSeverity() const override;
@@ -23,16 +32,42 @@ public:
     void printNested(
         const std::string& header,
         const std::vector<std::string>& lines = {},
-        const std::list<Message>& comments = {},
+        History comments = {},
         const std::optional<std::string>& status = std::nullopt
     );
+    void flush();       //waits until everything logged so far is on the terminal
 
 private:
+    struct Record {
+        std::optional<std::string> header;      //nested records have it, their comments are indented
+        std::vector<std::string> lines;
+        History comments;
+        bool colored;
+    };
+
+    void push(Record&& record) const;
+    void sink();
+    void printRecord(const Record& record) const;
     void printMessage(const Message& message, bool colored = false) const;
-    void finishPrint(bool colored = false) const;
+    void redrawStatus(bool lineCleared);
 
 private:
     std::atomic<Severity> severity;
-    mutable std::mutex mutex;
-    std::optional<std::string> status;
+    mutable Ring<Record> records;
+    mutable std::atomic<uint64_t> pushed;
+    uint64_t printed;
+    mutable std::mutex spaceMutex;
+    mutable std::condition_variable spaceConditional;
+    mutable std::atomic<unsigned int> parked;       //producers waiting for the ring to have space
+    std::shared_ptr<const std::string> status;      //only replaced and read with std::atomic_store and std::atomic_load, no lock
+    std::atomic<bool> statusChanged;
+    mutable std::mutex sinkMutex;
+    mutable std::condition_variable sinkConditional;
+    std::condition_variable flushConditional;
+    bool running;
+    mutable std::atomic<bool> wake;     //set outside of the lock too, the timeout of the sink covers a missed one
+    bool force;
+    bool statusShown;       //the rest belongs to the sink thread
+    std::chrono::steady_clock::time_point lastRedraw;
+    std::thread thread;
 };
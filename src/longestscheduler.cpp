@@ -0,0 +1,96 @@
+#include "longestscheduler.h"
+
+#include <algorithm>
+
+LongestScheduler::LongestScheduler():
+    planning(true),
+    terminate(false),
+    mutex(),
+    loopConditional(),
+    conversions(),
+    copies()
+{}
+
+void LongestScheduler::push(Job&& job) {
+    std::unique_lock lock(mutex);
+    switch (job.type) {
+        case Job::convert:
+            conversions.push_back(std::move(job));
+            std::push_heap(conversions.begin(), conversions.end(), shorter);
+            if (planning)
+                return;         //no one can take it yet, no need to wake anyone
+
+            break;
+        case Job::copy:
+            copies.push(std::move(job));
+            break;
+    }
+    lock.unlock();
+    loopConditional.notify_one();
+}
+
+std::optional<Job> LongestScheduler::pop(unsigned int worker) {
+    (void)(worker);
+    std::unique_lock lock(mutex);
+    while (!terminate && copies.empty() && (planning || conversions.empty()))
+        loopConditional.wait(lock);
+
+    if (terminate)
+        return std::nullopt;
+
+    if (planning || conversions.empty()) {
+        std::optional<Job> job(std::move(copies.front()));
+        copies.pop();
+        return job;
+    }
+
+    std::pop_heap(conversions.begin(), conversions.end(), shorter);
+    std::optional<Job> job(std::move(conversions.back()));
+    conversions.pop_back();
+    return job;
+}
+
+void LongestScheduler::finishPushing() {
+    std::unique_lock lock(mutex);
+    planning = false;
+    lock.unlock();
+
+    loopConditional.notify_all();
+}
+
+std::vector<std::filesystem::path> LongestScheduler::upcoming(std::size_t count) {
+    std::vector<std::filesystem::path> result;
+    std::lock_guard lock(mutex);
+    if (planning)
+        return result;      //nothing is given out yet, the order can still change
+
+    std::size_t candidates = conversions.size();     //the longest k are somewhere in the first k levels of the heap
+    if (count < 16)
+        candidates = std::min(candidates, (std::size_t(1) << count) - 1);
+
+    std::vector<const Job*> longest;
+    longest.reserve(candidates);
+    for (std::size_t i = 0; i < candidates; ++i)
+        longest.push_back(&conversions[i]);
+
+    count = std::min(count, longest.size());
+    std::partial_sort(longest.begin(), longest.begin() + count, longest.end(), [] (const Job* a, const Job* b) {
+        return shorter(*b, *a);
+    });
+    for (std::size_t i = 0; i < count; ++i)
+        result.push_back(longest[i]->source());
+
+    return result;
+}
+
+void LongestScheduler::stop() {
+    std::unique_lock lock(mutex);
+    terminate = true;
+    lock.unlock();
+
+    loopConditional.notify_all();
+}
+
+bool LongestScheduler::shorter(const Job& a, const Job& b) {
+    return a.cost < b.cost;
+}
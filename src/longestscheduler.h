@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+
+#include "scheduler.h"
+
+//Holds the conversions back until everything is found and then gives out the longest first,
+//so that the run doesn't end with one thread encoding a huge file that was found last.
+//Copies are given out right away and whenever there is no conversion left, they fill the gaps.
+//It has to see every job before it starts, so the queue limit doesn't apply
+class LongestScheduler : public Scheduler {
+public:
+    LongestScheduler();
+
+    void push(Job&& job) override;
+    std::optional<Job> pop(unsigned int worker) override;
+    void finishPushing() override;
+    std::vector<std::filesystem::path> upcoming(std::size_t count) override;
+    void stop() override;
+
+private:
+    static bool shorter(const Job& a, const Job& b);
+
+private:
+    bool planning;
+    bool terminate;
+    std::mutex mutex;
+    std::condition_variable loopConditional;
+    std::vector<Job> conversions;       //a heap, the longest is on the top
+    std::queue<Job> copies;
+};
@@ -12,6 +12,12 @@
 #include "collection.h"
 #include "taskmanager.h"
 #include "settings.h"
+#include "manifest.h"
+#include "perfcounters.h"
+#include "ioring.h"
+#include "pcmconverter.h"
+#include "resampler.h"
+#include "trace.h"
 #include "logger/logger.h"
 
 int main(int argc, char **argv) {
@@ -57,19 +63,78 @@ int main(int argc, char **argv) {
     }
 
     logger->setSeverity(settings->getLogLevel());
-    std::shared_ptr<TaskManager> taskManager = std::make_shared<TaskManager>(settings, logger);
+    std::string tracePath = settings->getTracePath();
+    if (!tracePath.empty()) {
+        Trace::enable();
+        Trace::nameThread("main");
+    }
+
+    if (settings->isPerfCounting() && !PerfCounters::enable())
+        std::cout << "Couldn't open the hardware performance counters, "
+                  << "the kernel might not allow it (see /proc/sys/kernel/perf_event_paranoid), continuing without them" << std::endl;
+
+    if (settings->getIOBackend() == Settings::uring && !IORing::enable())
+        std::cout << "Couldn't set up io_uring, the kernel might not have it or not allow it "
+                  << "(see /proc/sys/kernel/io_uring_disabled), continuing with blocking IO" << std::endl;
+
+    logger->debug("PCM conversion kernels: ", PCMConverter::kernelName(), ", resampler kernels: ", Resampler::kernelName());
+
+    std::shared_ptr<Manifest> manifest = std::make_shared<Manifest>(output);
+    manifest->read();
+    if (manifest->isResumed())
+        std::cout << "Resuming the interrupted run, the files it has finished are not going to be encoded again" << std::endl;
+
+    std::shared_ptr<TaskManager> taskManager = std::make_shared<TaskManager>(settings, logger, manifest);
     taskManager->start();
 
     std::chrono::time_point start = std::chrono::system_clock::now();
-    Collection collection(input, taskManager, settings);
+    Collection collection(input, taskManager, settings, logger);
     collection.convert(output);
+    taskManager->finishQueueing();
 
     taskManager->wait();
+    logger->flush();
     std::cout << std::endl;
     taskManager->stop();
 
+    if (!manifest->write())
+        std::cout << "Couldn't write the manifest to " << output << ", the next run is going to encode everything again" << std::endl;
+
+    unsigned int skipped = taskManager->getSkippedTasks();
+    if (skipped > 0)
+        std::cout << skipped << " files were up to date and were skipped" << std::endl;
+
+    unsigned int reused = taskManager->getReusedTasks();
+    if (reused > 0)
+        std::cout << reused << " files were moved or renamed, their previous output was reused" << std::endl;
+
+    constexpr uint64_t mebibyte = 1024 * 1024;
+    TaskManager::MemoryStatistics memory = taskManager->getMemoryStatistics();
+    if (memory.peak > 0) {
+        std::cout << "Memory usage peaked at " << memory.peak / mebibyte << " MiB";
+        if (memory.maxResident > 0)     //only measured after every task with a memory budget or a report
+            std::cout << ", after a task it was " << memory.averageResident / mebibyte << " MiB on average "
+                      << "and " << memory.maxResident / mebibyte << " MiB at most";
+
+        std::cout << std::endl;
+        if (memory.largestPeakRise > 0)
+            std::cout << "The peak of the process rose the most, by " << memory.largestPeakRise / mebibyte << " MiB, "
+                      << "while " << memory.largestPeakRiseSource << " was one of the running tasks"
+                      << " (it was estimated at " << memory.largestPeakRiseEstimate / mebibyte << " MiB)" << std::endl;
+    }
+
     std::chrono::time_point end = std::chrono::system_clock::now();
     std::chrono::duration<double> seconds = end - start;
+    if (!taskManager->writeReport(seconds.count()))
+        std::cout << "Couldn't write the report to " << settings->getReportPath() << std::endl;
+
+    std::string counters = taskManager->countersSummary();
+    if (!counters.empty())
+        std::cout << "Hardware counters by stage:\n" << counters;
+
+    if (!tracePath.empty() && !Trace::write(tracePath))
+        std::cout << "Couldn't write the trace to " << tracePath << std::endl;
+
     std::cout  << "Encoding is done, it took " << seconds.count() << " seconds in total, enjoy!" << std::endl;
 
     return 0;
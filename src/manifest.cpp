@@ -0,0 +1,422 @@
+#include "manifest.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include <metadata.h>
+
+namespace fs = std::filesystem;
+
+static const std::string fileName(".mlc.manifest");
+static const std::string journalName(".mlc.journal");
+static const std::string header("# mlc manifest 1");
+constexpr char separator = '\t';
+constexpr std::string_view hexDigits("0123456789abcdef");
+constexpr uint64_t digestPrime = 0x100000001b3;         //64 bit FNV-1a, Manifest::noTags is its basis
+
+static void digest(uint64_t& hash, const void* data, std::size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (std::size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * digestPrime;
+}
+
+void Manifest::digestTags(uint64_t& hash, const FLAC__StreamMetadata& block) {
+    switch (block.type) {
+        case FLAC__METADATA_TYPE_VORBIS_COMMENT: {
+            digest(hash, &block.type, sizeof(block.type));
+            const FLAC__StreamMetadata_VorbisComment& tags = block.data.vorbis_comment;
+            for (FLAC__uint32 i = 0; i < tags.num_comments; ++i)
+                digest(hash, tags.comments[i].entry, tags.comments[i].length + 1);      //with the terminating zero, so the borders count
+        }   break;
+        case FLAC__METADATA_TYPE_PICTURE: {
+            const FLAC__StreamMetadata_Picture& picture = block.data.picture;
+            digest(hash, &block.type, sizeof(block.type));
+            digest(hash, &picture.type, sizeof(picture.type));
+            digest(hash, picture.mime_type, std::strlen(picture.mime_type) + 1);
+            digest(hash, picture.description, std::strlen(reinterpret_cast<const char*>(picture.description)) + 1);
+            digest(hash, picture.data, picture.data_length);
+        }   break;
+        default:
+            break;
+    }
+}
+
+Manifest::Manifest(const std::filesystem::path& root):
+    root(fs::weakly_canonical(fs::absolute(root))),
+    file(Manifest::root / fileName),
+    journalFile(Manifest::root / journalName),
+    mutex(),
+    entries(),
+    identities(),
+    journaled(),
+    journalStream(),
+    modified(false)
+{}
+
+bool Manifest::read() {
+    std::lock_guard lock(mutex);
+    std::ifstream stream(file, std::ios::in);
+    std::string line;
+    bool ok = stream.is_open() && std::getline(stream, line) && line == header;
+    while (ok && std::getline(stream, line)) {    //unknown format is rebuilt from scratch
+        std::string name;
+        Entry entry;
+        if (!parse(line, name, entry))
+            continue;
+
+        std::pair<std::map<std::string, Entry>::iterator, bool> result = entries.emplace(name, entry);
+        if (result.second)
+            index(result.first);
+    }
+
+    replayJournal();
+    return ok;
+}
+
+void Manifest::replayJournal() {
+    std::ifstream stream(journalFile, std::ios::in);
+    if (!stream.is_open())
+        return;
+
+    std::string line;
+    while (std::getline(stream, line)) {
+        if (stream.eof())
+            break;          //no line end, the run was interrupted in the middle of this line
+
+        std::string name;
+        Entry entry;
+        if (parse(line, name, entry)) {
+            assign(name, entry);
+            journaled.insert(name);
+        } else if (line.find(separator) == std::string::npos) {
+            forget(line);
+            journaled.erase(line);
+        }
+    }
+}
+
+bool Manifest::isResumed() const {
+    std::lock_guard lock(mutex);
+    return !journaled.empty();
+}
+
+bool Manifest::wasJournaled(const std::filesystem::path& destination) const {
+    std::lock_guard lock(mutex);
+    return journaled.count(key(destination)) > 0;
+}
+
+bool Manifest::write() {
+    std::lock_guard lock(mutex);
+    if (!modified)
+        return true;
+
+    fs::path temp = file;
+    temp += ".part";
+    std::ofstream stream(temp, std::ios::out | std::ios::trunc);
+    if (!stream.is_open())
+        return false;
+
+    stream << header << '\n';
+    for (const std::pair<const std::string, Entry>& pair : entries)
+        stream << format(pair.first, pair.second) << '\n';
+
+    stream.close();
+    if (stream.fail())
+        return false;
+
+    std::error_code ec;
+    fs::rename(temp, file, ec);     //so that the interrupted write never leaves a broken manifest
+    if (ec)
+        return false;
+
+    journalStream.close();          //everything it had is in the manifest now
+    fs::remove(journalFile, ec);
+    journaled.clear();
+    modified = false;
+    return true;
+}
+
+bool Manifest::isUpToDate(const std::filesystem::path& destination, const Entry& entry) const {
+    std::unique_lock lock(mutex);
+    std::map<std::string, Entry>::const_iterator itr = entries.find(key(destination));
+    if (itr == entries.end())
+        return false;
+
+    const Entry& known = itr->second;
+    if (known.size != entry.size || known.mtime != entry.mtime || known.parameters != entry.parameters)
+        return false;
+
+    lock.unlock();
+    std::error_code ec;
+    return fs::exists(destination, ec);     //someone could have deleted the output by hand
+}
+
+void Manifest::update(const std::filesystem::path& destination, const Entry& entry) {
+    if (entry.source.find_first_of("\t\n") != std::string::npos)
+        return;
+
+    std::string name = key(destination);
+    if (name.find_first_of("\t\n") != std::string::npos)
+        return;
+
+    std::lock_guard lock(mutex);
+    assign(name, entry);
+    journal(format(name, entry));
+}
+
+void Manifest::erase(const std::filesystem::path& destination) {
+    std::string name = key(destination);
+    std::lock_guard lock(mutex);
+    if (entries.count(name) == 0)
+        return;
+
+    forget(name);
+    journal(name);
+}
+
+void Manifest::assign(const std::string& name, const Entry& entry) {
+    std::map<std::string, Entry>::iterator itr = entries.find(name);
+    if (itr != entries.end()) {
+        unindex(name, itr->second);
+        itr->second = entry;
+    } else {
+        itr = entries.emplace(name, entry).first;
+    }
+    index(itr);
+    modified = true;
+}
+
+void Manifest::forget(const std::string& name) {
+    std::map<std::string, Entry>::iterator itr = entries.find(name);
+    if (itr == entries.end())
+        return;
+
+    unindex(name, itr->second);
+    entries.erase(itr);
+    modified = true;
+}
+
+void Manifest::journal(const std::string& line) {
+    if (!journalStream.is_open())
+        journalStream.open(journalFile, std::ios::out | std::ios::app);
+
+    journalStream << line << '\n';
+    journalStream.flush();      //a killed process still leaves it to the system, only a power loss can take the last lines
+}
+
+bool Manifest::mightHaveIdentical(const std::filesystem::path& destination) const {
+    std::string name = key(destination);
+    std::lock_guard lock(mutex);
+    for (const std::pair<const MD5, std::map<std::string, Entry>::const_iterator>& pair : identities) {   //the audio MD5 isn't known yet, reading it is worth only if anything could match
+        if (pair.second->first != name)
+            return true;
+    }
+
+    return false;
+}
+
+std::optional<std::pair<std::filesystem::path, Manifest::Entry>> Manifest::findIdentical(
+    const std::filesystem::path& destination,
+    const Entry& entry
+) const {
+    if (entry.md5 == MD5() || entry.tags == 0)
+        return std::nullopt;    //encoder didn't compute the MD5, there is no way to tell the audio is the same
+
+    std::string name = key(destination);
+    std::optional<std::pair<std::filesystem::path, Entry>> result = std::nullopt;
+    std::lock_guard lock(mutex);
+    auto range = identities.equal_range(entry.md5);
+    for (auto itr = range.first; itr != range.second; ++itr) {
+        if (itr->second->first == name)
+            continue;
+
+        const Entry& candidate = itr->second->second;
+        if (candidate.tags != entry.tags || candidate.parameters != entry.parameters)
+            continue;           //the same audio with other tags would need an output with other tags, it's encoded again
+
+        std::error_code ec;
+        fs::path output = root / itr->second->first;
+        if (!fs::exists(output, ec))
+            continue;
+
+        result = std::make_pair(output, candidate);
+        if (!fs::exists(candidate.source, ec))
+            break;              //the one that was moved away is the best match, there is no one else to use it
+    }
+
+    return result;
+}
+
+bool Manifest::describe(const std::filesystem::path& source, Entry& entry) {
+    struct stat info;
+    if (::stat(source.c_str(), &info) != 0) {
+        entry.source = source.string();
+        return false;
+    }
+
+    describe(source, info, entry);
+    return true;
+}
+
+void Manifest::describe(const std::filesystem::path& source, const struct stat& info, Entry& entry) {
+    entry.source = source.string();
+    entry.size = info.st_size;
+    entry.mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+bool Manifest::identify(const std::filesystem::path& source, Entry& entry) {
+    FLAC__Metadata_SimpleIterator* iterator = FLAC__metadata_simple_iterator_new();
+    if (iterator == nullptr)
+        return false;
+
+    bool found = false;
+    uint64_t tags = noTags;
+    if (FLAC__metadata_simple_iterator_init(iterator, source.c_str(), true, false)) {
+        do {
+            FLAC__MetadataType type = FLAC__metadata_simple_iterator_get_block_type(iterator);
+            if (type != FLAC__METADATA_TYPE_STREAMINFO && type != FLAC__METADATA_TYPE_VORBIS_COMMENT && type != FLAC__METADATA_TYPE_PICTURE)
+                continue;
+
+            FLAC__StreamMetadata* block = FLAC__metadata_simple_iterator_get_block(iterator);
+            if (block == nullptr)
+                continue;
+
+            if (type == FLAC__METADATA_TYPE_STREAMINFO) {
+                const FLAC__byte* md5 = block->data.stream_info.md5sum;
+                std::copy(md5, md5 + entry.md5.size(), entry.md5.begin());
+                found = true;
+            } else {
+                digestTags(tags, *block);
+            }
+            FLAC__metadata_object_delete(block);
+        } while (FLAC__metadata_simple_iterator_next(iterator));
+    }
+
+    FLAC__metadata_simple_iterator_delete(iterator);
+    entry.tags = found ? tags : 0;
+    return found;
+}
+
+std::string Manifest::encodingParameters(const std::shared_ptr<Settings>& settings) {
+    std::string result;
+    switch (settings->getType()) {
+        case Settings::mp3:
+            result = "mp3";
+            break;
+        default:
+            result = "unknown";
+            break;
+    }
+    result += " quality " + std::to_string(settings->getEncodingQuality());
+    result += " output " + std::to_string(settings->getOutputQuality());
+    result += settings->getVBR() ? " vbr" : " cbr";
+    result += " float";         //LAME gets planar floats, so the outputs of the earlier versions, encoded from 16 bit samples, are encoded again
+    if (settings->getSampleRate() != 0)     //the default rate and resampler add nothing, so the manifests of the earlier versions stay valid
+        result += " rate " + std::to_string(settings->getSampleRate());
+    if (settings->getResampling() == Settings::polyphase)
+        result += " polyphase resampler";
+
+    return result;
+}
+
+std::string Manifest::copyParameters() {
+    return "copy";
+}
+
+std::string Manifest::key(const std::filesystem::path& destination) const {
+    return destination.lexically_relative(root).generic_string();
+}
+
+void Manifest::index(std::map<std::string, Entry>::const_iterator itr) {
+    const Entry& entry = itr->second;
+    if (entry.md5 != MD5() && entry.tags != 0)
+        identities.emplace(entry.md5, itr);     //the nodes of the map don't move, the name isn't stored twice
+}
+
+void Manifest::unindex(const std::string& name, const Entry& entry) {
+    auto range = identities.equal_range(entry.md5);
+    for (auto itr = range.first; itr != range.second; ++itr) {
+        if (itr->second->first == name) {
+            identities.erase(itr);
+            return;
+        }
+    }
+}
+
+std::string Manifest::format(const std::string& name, const Entry& entry) {
+    std::ostringstream stream;
+    stream << name << separator
+           << entry.source << separator
+           << entry.size << separator
+           << entry.mtime << separator
+           << toHex(entry.md5) << separator
+           << entry.parameters << separator
+           << entry.tags;
+
+    return stream.str();
+}
+
+bool Manifest::parse(const std::string& line, std::string& name, Entry& entry) {
+    std::vector<std::string> fields;
+    std::string field;
+    std::istringstream lineStream(line);
+    while (std::getline(lineStream, field, separator))
+        fields.push_back(field);
+
+    if (fields.size() != 6 && fields.size() != 7)     //the older ones have no tag digest, they are never reused
+        return false;
+
+    try {
+        entry.size = std::stoull(fields[2]);
+        entry.mtime = std::stoll(fields[3]);
+        entry.tags = fields.size() > 6 ? std::stoull(fields[6]) : 0;
+    } catch (...) {
+        return false;
+    }
+    if (!fromHex(fields[4], entry.md5))
+        return false;
+
+    name = fields[0];
+    entry.source = fields[1];
+    entry.parameters = fields[5];
+    return true;
+}
+
+std::string Manifest::toHex(const MD5& md5) {
+    std::string result;
+    result.reserve(md5.size() * 2);
+    for (uint8_t byte : md5) {
+        result += hexDigits[byte >> 4];
+        result += hexDigits[byte & 0x0f];
+    }
+
+    return result;
+}
+
+bool Manifest::fromHex(const std::string& hex, MD5& md5) {
+    if (hex.size() != md5.size() * 2)
+        return false;
+
+    for (std::size_t i = 0; i < md5.size(); ++i) {
+        std::string::size_type high = hexDigits.find(hex[i * 2]);
+        std::string::size_type low = hexDigits.find(hex[i * 2 + 1]);
+        if (high == std::string_view::npos || low == std::string_view::npos)
+            return false;
+
+        md5[i] = (high << 4) | low;
+    }
+
+    return true;
+}
+
+Manifest::Entry::Entry():
+    source(),
+    size(0),
+    mtime(0),
+    md5(),
+    tags(0),
+    parameters()
+{}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <array>
+#include <map>
+#include <set>
+#include <optional>
+#include <fstream>
+#include <mutex>
+#include <memory>
+#include <filesystem>
+
+#include <sys/stat.h>
+
+#include <format.h>
+
+#include "settings.h"
+
+class Manifest {
+public:
+    struct Entry;
+    using MD5 = std::array<uint8_t, 16>;
+    static constexpr uint64_t noTags = 0xcbf29ce484222325;     //the digest of no blocks, it starts from here
+
+    Manifest(const std::filesystem::path& root);
+
+    bool read();
+    bool write();
+    bool isResumed() const;
+
+    bool isUpToDate(const std::filesystem::path& destination, const Entry& entry) const;
+    void update(const std::filesystem::path& destination, const Entry& entry);
+    void erase(const std::filesystem::path& destination);
+
+    bool wasJournaled(const std::filesystem::path& destination) const;
+    bool mightHaveIdentical(const std::filesystem::path& destination) const;
+    std::optional<std::pair<std::filesystem::path, Entry>> findIdentical(const std::filesystem::path& destination, const Entry& entry) const;
+
+    static bool describe(const std::filesystem::path& source, Entry& entry);
+    static void describe(const std::filesystem::path& source, const struct stat& info, Entry& entry);
+    static bool identify(const std::filesystem::path& source, Entry& entry);
+    static void digestTags(uint64_t& hash, const FLAC__StreamMetadata& block);    //vorbis comments and pictures, other blocks leave it as it is
+    static std::string encodingParameters(const std::shared_ptr<Settings>& settings);
+    static std::string copyParameters();
+
+private:
+    std::string key(const std::filesystem::path& destination) const;
+    void index(std::map<std::string, Entry>::const_iterator itr);
+    void unindex(const std::string& name, const Entry& entry);
+    void assign(const std::string& name, const Entry& entry);
+    void forget(const std::string& name);
+    void replayJournal();
+    void journal(const std::string& line);
+
+    static std::string format(const std::string& name, const Entry& entry);
+    static bool parse(const std::string& line, std::string& name, Entry& entry);
+
+    static std::string toHex(const MD5& md5);
+    static bool fromHex(const std::string& hex, MD5& md5);
+
+private:
+    std::filesystem::path root;
+    std::filesystem::path file;
+    std::filesystem::path journalFile;  //every finished job is appended here right away, the manifest is only written at the end
+    mutable std::mutex mutex;
+    std::map<std::string, Entry> entries;
+    std::multimap<MD5, std::map<std::string, Entry>::const_iterator> identities;    //outputs by the audio MD5 of their sources, the candidates for reuse
+    std::set<std::string> journaled;    //outputs an interrupted run has finished
+    std::ofstream journalStream;
+    bool modified;
+};
+
+struct Manifest::Entry {
+    Entry();
+
+    std::string source;
+    uint64_t size;
+    int64_t mtime;          //nanoseconds since epoch, as stat reports them
+    MD5 md5;                //STREAMINFO audio MD5, zeros for copies and unknown
+    uint64_t tags;          //digest of the tags and pictures that go to the output, 0 for copies and unknown
+    std::string parameters; //whatever affects the output, see encodingParameters
+};
@@ -0,0 +1,77 @@
+#include "memorybudget.h"
+
+#include <fstream>
+#include <string>
+#include <sstream>
+
+MemoryBudget::MemoryBudget(uint64_t limit):
+    limit(limit),
+    used(0),
+    kept(0),
+    nextTicket(0),
+    serving(0),
+    mutex(),
+    conditional()
+{}
+
+void MemoryBudget::acquire(uint64_t amount) {
+    if (limit == 0)
+        return;
+
+    std::unique_lock lock(mutex);
+    uint64_t ticket = nextTicket++;
+    while (ticket != serving || (used != kept && used + amount > limit))
+        conditional.wait(lock);
+
+    used += amount;
+    ++serving;
+    lock.unlock();
+
+    conditional.notify_all();       //the next one in line might fit too
+}
+
+void MemoryBudget::release(uint64_t amount) {
+    if (limit == 0)
+        return;
+
+    std::unique_lock lock(mutex);
+    used -= amount;
+    lock.unlock();
+
+    conditional.notify_all();       //a few small jobs might fit where a big one was
+}
+
+void MemoryBudget::keep(uint64_t amount) {
+    if (limit == 0)
+        return;
+
+    std::lock_guard lock(mutex);
+    kept += amount;
+}
+
+uint64_t MemoryBudget::getLimit() const {
+    return limit;
+}
+
+uint64_t MemoryBudget::residentSize() {
+    return readStatus("VmRSS:");
+}
+
+uint64_t MemoryBudget::peakResidentSize() {
+    return readStatus("VmHWM:");
+}
+
+uint64_t MemoryBudget::readStatus(const char* field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind(field, 0) != 0)
+            continue;
+
+        uint64_t kibibytes = 0;
+        std::istringstream(line.substr(line.find(':') + 1)) >> kibibytes;
+        return kibibytes * 1024;
+    }
+
+    return 0;
+}
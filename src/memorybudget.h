@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+
+//Admits jobs while the sum of their estimated footprints fits the limit.
+//A job that alone is bigger than the limit still runs, but only when nothing else does.
+//Jobs are admitted in the order they come, so the small ones can't keep a big one waiting forever.
+//A part of what a job took can be kept after it's released, for what its thread holds on to until the end of the run
+class MemoryBudget {
+public:
+    MemoryBudget(uint64_t limit);
+
+    void acquire(uint64_t amount);
+    void release(uint64_t amount);
+    void keep(uint64_t amount);
+    uint64_t getLimit() const;
+
+    static uint64_t residentSize();         //what the process has in RAM now, 0 if it's unknown
+    static uint64_t peakResidentSize();     //the most the process had in RAM since it started
+
+private:
+    static uint64_t readStatus(const char* field);
+
+private:
+    const uint64_t limit;
+    uint64_t used;
+    uint64_t kept;              //the part of used that no job is going to give back
+    uint64_t nextTicket;
+    uint64_t serving;
+    std::mutex mutex;
+    std::condition_variable conditional;
+};
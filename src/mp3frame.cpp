@@ -0,0 +1,108 @@
+#include "mp3frame.h"
+
+#include <algorithm>
+#include <string_view>
+
+constexpr std::array<uint16_t, 16> mpeg1Bitrates({0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0});
+constexpr std::array<uint16_t, 16> mpeg2Bitrates({0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0});
+constexpr std::array<uint32_t, 4> mpeg1SampleRates({44100, 48000, 32000, 0});
+
+constexpr std::string_view xing("Xing");
+constexpr std::string_view info("Info");
+constexpr uint32_t allXingFields = 0x0f;      //frames, bytes, TOC and quality, LAME always writes all of them
+constexpr std::size_t xingSize = 120;         //marker, flags, frames, bytes, TOC, quality
+constexpr std::size_t lameDelayOffset = 21;
+constexpr std::size_t lameMusicLengthOffset = 28;
+constexpr std::size_t lameMusicCRCOffset = 32;
+constexpr std::size_t lameTagCRCOffset = 34;
+constexpr std::size_t lameSize = 36;
+
+static void writeBigEndian(uint8_t* destination, uint32_t value, std::size_t bytes) {
+    for (std::size_t i = 0; i < bytes; ++i)
+        destination[i] = value >> (8 * (bytes - i - 1));
+}
+
+static uint32_t readBigEndian(const uint8_t* source) {
+    return (uint32_t(source[0]) << 24) | (uint32_t(source[1]) << 16) | (uint32_t(source[2]) << 8) | source[3];
+}
+
+uint32_t MP3Frame::length(const uint8_t* header) {
+    if (header[0] != 0xff || (header[1] & 0xe0) != 0xe0)
+        return 0;
+
+    uint8_t version = (header[1] >> 3) & 0x03;      //0 - MPEG 2.5, 1 - reserved, 2 - MPEG 2, 3 - MPEG 1
+    uint8_t layer = (header[1] >> 1) & 0x03;        //1 - layer III
+    if (version == 1 || layer != 1)
+        return 0;
+
+    uint8_t bitrateIndex = header[2] >> 4;
+    uint8_t sampleRateIndex = (header[2] >> 2) & 0x03;
+    uint32_t padding = (header[2] >> 1) & 0x01;
+
+    uint32_t sampleRate = mpeg1SampleRates[sampleRateIndex];
+    if (version != 3)
+        sampleRate /= version == 2 ? 2 : 4;
+
+    uint32_t bitrate = version == 3 ? mpeg1Bitrates[bitrateIndex] : mpeg2Bitrates[bitrateIndex];
+    if (bitrate == 0 || sampleRate == 0)
+        return 0;               //free format is never produced by LAME, the rest is garbage
+
+    uint32_t coefficient = version == 3 ? 144000 : 72000;
+    return coefficient * bitrate / sampleRate + padding;
+}
+
+uint16_t MP3Frame::crc(const uint8_t* data, std::size_t size, uint16_t crc) {
+    for (std::size_t i = 0; i < size; ++i) {    //CRC-16 with the reversed 0x8005 polynomial, the one LAME uses for its tag
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xa001 : crc >> 1;
+    }
+
+    return crc;
+}
+
+MP3Frame::TOC MP3Frame::toc(const std::vector<uint32_t>& frameSizes, uint32_t offset, uint32_t bytes) {
+    TOC result;
+    uint64_t position = offset;
+    std::size_t frame = 0;
+    for (std::size_t i = 0; i < result.size(); ++i) {
+        std::size_t target = i * frameSizes.size() / result.size();
+        for (; frame < target; ++frame)
+            position += frameSizes[frame];
+
+        result[i] = std::min<uint64_t>(255, position * 256 / std::max<uint32_t>(bytes, 1));
+    }
+
+    return result;
+}
+
+bool MP3Frame::patchInfoTag(std::vector<uint8_t>& tag, const Info& description) {
+    if (tag.size() < headerSize || length(tag.data()) != tag.size())
+        return false;
+
+    std::string_view content(reinterpret_cast<const char*>(tag.data()), tag.size());
+    std::size_t marker = content.find(xing);
+    if (marker == std::string_view::npos)
+        marker = content.find(info);
+
+    if (marker == std::string_view::npos || marker + xingSize + lameSize > tag.size())
+        return false;
+
+    uint8_t* xingTag = tag.data() + marker;
+    if (readBigEndian(xingTag + 4) != allXingFields)
+        return false;
+
+    writeBigEndian(xingTag + 8, description.frames, 4);
+    writeBigEndian(xingTag + 12, description.bytes, 4);
+    std::copy(description.toc.begin(), description.toc.end(), xingTag + 16);
+
+    uint8_t* lameTag = xingTag + xingSize;
+    writeBigEndian(lameTag + lameDelayOffset, (uint32_t(description.delay & 0xfff) << 12) | (description.padding & 0xfff), 3);
+    writeBigEndian(lameTag + lameMusicLengthOffset, description.bytes, 4);
+    writeBigEndian(lameTag + lameMusicCRCOffset, description.musicCRC, 2);
+
+    std::size_t covered = lameTag + lameTagCRCOffset - tag.data();
+    writeBigEndian(lameTag + lameTagCRCOffset, crc(tag.data(), covered), 2);
+
+    return true;
+}
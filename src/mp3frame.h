@@ -0,0 +1,27 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class MP3Frame {
+public:
+    using TOC = std::array<uint8_t, 100>;
+
+    struct Info {
+        uint32_t frames;        //audio frames, the tag frame itself is not counted
+        uint32_t bytes;         //the tag frame and all the audio frames
+        TOC toc;
+        uint16_t delay;
+        uint16_t padding;
+        uint16_t musicCRC;
+    };
+
+    static constexpr std::size_t headerSize = 4;
+
+    static uint32_t length(const uint8_t* header);
+    static uint16_t crc(const uint8_t* data, std::size_t size, uint16_t crc = 0);
+    static TOC toc(const std::vector<uint32_t>& frameSizes, uint32_t offset, uint32_t bytes);
+    static bool patchInfoTag(std::vector<uint8_t>& tag, const Info& info);
+};
@@ -0,0 +1,232 @@
+#include "outputwriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <optional>
+#include <fcntl.h>
+#include <unistd.h>
+
+constexpr std::size_t blocksInFlight = 4;
+
+OutputWriter::OutputWriter(std::size_t blockSize):
+    blockSize(blockSize),
+    file(-1),
+    head(),
+    buffer(),
+    bufferPosition(0),
+    reserved(0),
+    failed(false),
+    ring(),
+    blocks()
+{}
+
+OutputWriter::~OutputWriter() {
+    close();
+}
+
+bool OutputWriter::open(const std::string& path) {
+    close();
+    file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (file == -1)
+        return false;
+
+    buffer.reserve(blockSize);
+    bufferPosition = 0;
+    reserved = 0;
+    failed = false;
+    if (!ring)
+        ring = IORing::create(blocksInFlight);
+
+    return true;
+}
+
+void OutputWriter::reserve(uint64_t bytes) {
+    if (file == -1 || bytes <= reserved)
+        return;
+
+    bytes = (bytes + blockSize - 1) / blockSize * blockSize;
+    if (::fallocate(file, 0, 0, bytes) == 0)       //not every filesystem can, the writes just extend the file then
+        reserved = bytes;
+}
+
+bool OutputWriter::write(const uint8_t* data, std::size_t size) {
+    if (failed || file == -1)
+        return false;
+
+    while (size > 0) {
+        std::size_t chunk = std::min(size, blockSize - buffer.size());
+        buffer.insert(buffer.end(), data, data + chunk);
+        data += chunk;
+        size -= chunk;
+        if (buffer.size() == blockSize && !writeBlock())
+            return false;
+    }
+
+    return true;
+}
+
+bool OutputWriter::patch(uint64_t position, const uint8_t* data, std::size_t size) {
+    if (failed || file == -1 || position + size > tell())
+        return false;
+
+    if (position < head.size()) {
+        std::size_t chunk = std::min<uint64_t>(size, head.size() - position);
+        std::copy(data, data + chunk, head.begin() + position);
+        position += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+
+    if (size > 0 && position < bufferPosition) {        //it's already on the disk
+        if (!drain())
+            return false;
+
+        std::size_t chunk = std::min<uint64_t>(size, bufferPosition - position);
+        if (!writeAt(position, data, chunk))
+            return false;
+
+        position += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+
+    if (size > 0)
+        std::copy(data, data + size, buffer.begin() + (position - bufferPosition));
+
+    return true;
+}
+
+bool OutputWriter::finish(bool sync) {
+    if (failed || file == -1)
+        return false;
+
+    bool ok = drain();
+    if (ok && !buffer.empty())
+        ok = writeAt(bufferPosition, buffer.data(), buffer.size());
+
+    if (ok && !head.empty())
+        ok = writeAt(0, head.data(), head.size());
+
+    uint64_t size = tell();
+    if (ok && reserved > size)      //gives back what the estimate had too much
+        ok = ::ftruncate(file, size) == 0;
+
+    if (ok && sync)
+        ok = ::fsync(file) == 0;
+
+    failed = !ok;
+    return ok;
+}
+
+bool OutputWriter::close() {
+    drain();
+    head.clear();           //the capacity is kept for the next file
+    buffer.clear();
+    bufferPosition = 0;
+    reserved = 0;
+    if (file == -1)
+        return true;
+
+    bool ok = ::close(file) == 0;
+    file = -1;
+    return ok;
+}
+
+uint64_t OutputWriter::tell() const {
+    return bufferPosition + buffer.size();
+}
+
+bool OutputWriter::writeBlock() {
+    if (bufferPosition == 0)
+        head.swap(buffer);
+    else if (ring && !submitBlock())
+        return false;
+    else if (!ring && !writeAt(bufferPosition, buffer.data(), buffer.size()))
+        return false;
+
+    bufferPosition += blockSize;
+    buffer.clear();
+    buffer.reserve(blockSize);
+    return true;
+}
+
+bool OutputWriter::submitBlock() {
+    if (blocks.empty())
+        blocks.resize(blocksInFlight, {{}, 0, 0, false});
+
+    std::vector<Block>::iterator block = std::find_if(blocks.begin(), blocks.end(), [] (const Block& block) {return !block.busy;});
+    while (block == blocks.end()) {
+        if (!reap() || failed)
+            return false;
+
+        block = std::find_if(blocks.begin(), blocks.end(), [] (const Block& block) {return !block.busy;});
+    }
+
+    block->data.swap(buffer);
+    block->position = bufferPosition;
+    block->done = 0;
+    if (!ring->write(file, block->data.data(), block->data.size(), bufferPosition, block - blocks.begin()))
+        return writeAt(bufferPosition, block->data.data(), block->data.size());
+
+    block->busy = true;
+    ring->submit();
+    return true;
+}
+
+bool OutputWriter::reap() {
+    std::optional<IORing::Completion> done = ring->wait();
+    if (!done.has_value()) {
+        failed = true;
+        return false;
+    }
+
+    Block& block = blocks[done->tag];
+    block.busy = false;
+    bool unsupported = IORing::isUnsupported(done->result);
+    if (done->result > 0)
+        block.done += done->result;
+    else if (!unsupported) {
+        failed = true;
+        return true;
+    }
+
+    if (block.done == block.data.size())
+        return true;
+
+    const uint8_t* rest = block.data.data() + block.done;
+    std::size_t size = block.data.size() - block.done;
+    uint64_t position = block.position + block.done;
+    if (!unsupported && ring->write(file, rest, size, position, done->tag)) {      //written short, the rest goes again
+        block.busy = true;
+        ring->submit();
+    } else {
+        writeAt(position, rest, size);      //the kernel or the filesystem can't do it through the ring
+    }
+
+    return true;
+}
+
+bool OutputWriter::drain() {
+    while (ring && ring->inFlight() > 0 && reap());
+
+    return !failed;
+}
+
+bool OutputWriter::writeAt(uint64_t position, const uint8_t* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t written = ::pwrite(file, data, size, position);
+        if (written == -1 && errno == EINTR)
+            continue;
+
+        if (written <= 0) {
+            failed = true;
+            return false;
+        }
+        position += written;
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "ioring.h"
+
+//Writes a file in large blocks that start at multiples of the block size.
+//The expected size can be reserved up front with fallocate, so the filesystem lays the file out in one piece
+//and the writes never wait for it to find space. The first block, where the tags and the Xing frame are,
+//stays in memory until the file is finished, so patching the Xing frame doesn't cost a seek and another write.
+//With io_uring the blocks are written in the background, a few at a time, while the next ones are encoded
+class OutputWriter {
+public:
+    static constexpr std::size_t defaultBlockSize = 1024 * 1024;
+
+    OutputWriter(std::size_t blockSize = defaultBlockSize);
+    ~OutputWriter();
+
+    bool open(const std::string& path);
+    void reserve(uint64_t bytes);
+    bool write(const uint8_t* data, std::size_t size);
+    bool patch(uint64_t position, const uint8_t* data, std::size_t size);
+    bool finish(bool sync);
+    bool close();
+
+    uint64_t tell() const;
+
+private:
+    struct Block {
+        std::vector<uint8_t> data;
+        uint64_t position;      //where in the file it goes
+        std::size_t done;       //how much of it is written
+        bool busy;              //the kernel is writing it
+    };
+
+    bool writeBlock();
+    bool submitBlock();
+    bool reap();
+    bool drain();
+    bool writeAt(uint64_t position, const uint8_t* data, std::size_t size);
+
+private:
+    const std::size_t blockSize;
+    int file;
+    std::vector<uint8_t> head;      //the first block, written the last
+    std::vector<uint8_t> buffer;
+    uint64_t bufferPosition;        //where in the file the buffer goes
+    uint64_t reserved;              //the size fallocate has extended the file to
+    bool failed;
+    std::unique_ptr<IORing> ring;
+    std::vector<Block> blocks;
+};
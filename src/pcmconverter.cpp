@@ -0,0 +1,201 @@
+#include "pcmconverter.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MLC_X86
+#endif
+
+constexpr float minus3dB = 0.70710678f;
+
+namespace {
+    void convertScalar(float scale, const int32_t* input, float* output, std::size_t frames) {
+        for (std::size_t i = 0; i < frames; ++i)
+            output[i] = input[i] * scale;
+    }
+
+    void downmixScalar(const PCMConverter::Matrix& matrix, const int32_t* const input[], std::size_t offset, float* left, float* right, std::size_t frames) {
+        for (std::size_t i = 0; i < frames; ++i) {
+            float l = 0;
+            float r = 0;
+            for (uint32_t channel = 0; channel < matrix.channels; ++channel) {
+                float sample = input[channel][offset + i];
+                l += sample * matrix.left[channel];
+                r += sample * matrix.right[channel];
+            }
+            left[i] = l;
+            right[i] = r;
+        }
+    }
+
+#ifdef MLC_X86
+    __attribute__((target("sse2")))
+    void convertSSE2(float scale, const int32_t* input, float* output, std::size_t frames) {
+        const __m128 factor = _mm_set1_ps(scale);
+        std::size_t i = 0;
+        for (; i + 8 <= frames; i += 8) {      //two vectors a round, so the conversions overlap
+            __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+            __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 4));
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(first), factor));
+            _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(second), factor));
+        }
+
+        convertScalar(scale, input + i, output + i, frames - i);
+    }
+
+    __attribute__((target("sse2")))
+    void downmixSSE2(const PCMConverter::Matrix& matrix, const int32_t* const input[], std::size_t offset, float* left, float* right, std::size_t frames) {
+        std::size_t i = 0;
+        for (; i + 4 <= frames; i += 4) {
+            __m128 l = _mm_setzero_ps();
+            __m128 r = _mm_setzero_ps();
+            for (uint32_t channel = 0; channel < matrix.channels; ++channel) {
+                __m128 sample = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input[channel] + offset + i)));
+                l = _mm_add_ps(l, _mm_mul_ps(sample, _mm_set1_ps(matrix.left[channel])));
+                r = _mm_add_ps(r, _mm_mul_ps(sample, _mm_set1_ps(matrix.right[channel])));
+            }
+            _mm_storeu_ps(left + i, l);
+            _mm_storeu_ps(right + i, r);
+        }
+
+        downmixScalar(matrix, input, offset + i, left + i, right + i, frames - i);
+    }
+
+    __attribute__((target("avx2")))
+    void convertAVX2(float scale, const int32_t* input, float* output, std::size_t frames) {
+        const __m256 factor = _mm256_set1_ps(scale);
+        std::size_t i = 0;
+        for (; i + 16 <= frames; i += 16) {
+            __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+            __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i + 8));
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(first), factor));
+            _mm256_storeu_ps(output + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(second), factor));
+        }
+
+        convertScalar(scale, input + i, output + i, frames - i);
+    }
+
+    __attribute__((target("avx2")))
+    void downmixAVX2(const PCMConverter::Matrix& matrix, const int32_t* const input[], std::size_t offset, float* left, float* right, std::size_t frames) {
+        std::size_t i = 0;
+        for (; i + 8 <= frames; i += 8) {
+            __m256 l = _mm256_setzero_ps();
+            __m256 r = _mm256_setzero_ps();
+            for (uint32_t channel = 0; channel < matrix.channels; ++channel) {
+                __m256 sample = _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(input[channel] + offset + i)));
+                l = _mm256_add_ps(l, _mm256_mul_ps(sample, _mm256_set1_ps(matrix.left[channel])));
+                r = _mm256_add_ps(r, _mm256_mul_ps(sample, _mm256_set1_ps(matrix.right[channel])));
+            }
+            _mm256_storeu_ps(left + i, l);
+            _mm256_storeu_ps(right + i, r);
+        }
+
+        downmixScalar(matrix, input, offset + i, left + i, right + i, frames - i);
+    }
+#endif
+}
+
+PCMConverter::PCMConverter():
+    channels(2),
+    scale(1.0f / (1 << 15)),
+    matrix(),
+    kernels(pickKernels())
+{}
+
+void PCMConverter::setFormat(uint32_t channels, uint32_t bitsPerSample) {
+    bitsPerSample = std::clamp(bitsPerSample, 4u, 32u);
+    PCMConverter::channels = std::clamp(channels, 1u, maxChannels);
+    scale = 1.0f / float(uint64_t(1) << (bitsPerSample - 1));     //a power of two, the multiplication is exact
+    matrix = downmixMatrix(PCMConverter::channels, scale);
+}
+
+uint32_t PCMConverter::getChannels() const {
+    return channels;
+}
+
+uint32_t PCMConverter::getOutputChannels() const {
+    return channels == 1 ? 1 : 2;
+}
+
+void PCMConverter::convert(const int32_t* const input[], std::size_t offset, float* left, float* right, std::size_t frames) const {
+    switch (channels) {
+        case 1:
+            kernels.kernel(scale, input[0] + offset, left, frames);
+            break;
+        case 2:
+            kernels.kernel(scale, input[0] + offset, left, frames);
+            kernels.kernel(scale, input[1] + offset, right, frames);
+            break;
+        default:
+            kernels.downmix(matrix, input, offset, left, right, frames);
+            break;
+    }
+}
+
+PCMConverter::Matrix PCMConverter::downmixMatrix(uint32_t channels, float scale) {
+    Matrix result;
+    result.channels = channels;
+    result.left.fill(0);
+    result.right.fill(0);
+    result.left[0] = 1;
+    result.right[1] = 1;
+    switch (channels) {     //the channel order of FLAC
+        case 3:             //left, right, center
+            result.left[2] = result.right[2] = minus3dB;
+            break;
+        case 4:             //left, right, back left, back right
+            result.left[2] = result.right[3] = minus3dB;
+            break;
+        case 5:             //left, right, center, back left, back right
+            result.left[2] = result.right[2] = minus3dB;
+            result.left[3] = result.right[4] = minus3dB;
+            break;
+        case 6:             //left, right, center, LFE, back left, back right
+            result.left[2] = result.right[2] = minus3dB;
+            result.left[4] = result.right[5] = minus3dB;
+            break;
+        case 7:             //left, right, center, LFE, back center, side left, side right
+            result.left[2] = result.right[2] = minus3dB;
+            result.left[4] = result.right[4] = minus3dB * minus3dB;
+            result.left[5] = result.right[6] = minus3dB;
+            break;
+        case 8:             //left, right, center, LFE, back left, back right, side left, side right
+            result.left[2] = result.right[2] = minus3dB;
+            result.left[4] = result.right[5] = minus3dB;
+            result.left[6] = result.right[7] = minus3dB;
+            break;
+        default:
+            break;
+    }
+
+    float sum = 0;      //both sides are symmetric, the left one tells how loud the loudest mix can get
+    for (float coefficient : result.left)
+        sum += coefficient;
+
+    for (uint32_t channel = 0; channel < maxChannels; ++channel) {
+        result.left[channel] *= scale / sum;
+        result.right[channel] *= scale / sum;
+    }
+
+    return result;
+}
+
+const PCMConverter::Kernels& PCMConverter::pickKernels() {
+    static const Kernels kernels = [] () -> Kernels {
+#ifdef MLC_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return {"AVX2", convertAVX2, downmixAVX2};
+        if (__builtin_cpu_supports("sse2"))
+            return {"SSE2", convertSSE2, downmixSSE2};
+#endif
+        return {"scalar", convertScalar, downmixScalar};
+    }();
+
+    return kernels;
+}
+
+std::string_view PCMConverter::kernelName() {
+    return pickKernels().name;
+}
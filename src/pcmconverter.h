@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+//Turns the integer samples of the FLAC decoder into the floats LAME takes, 1.0 being the full scale.
+//A float keeps every bit of up to 24 bit samples, so nothing is lost on the way to the encoder
+//and the channels go in as planes, the way the decoder gives them, without interleaving.
+//Mono and stereo are converted channel by channel, 3 to 8 channels are mixed down to stereo
+//in the same pass with the usual matrices: the center and the surrounds at -3 dB, no LFE,
+//every side scaled so the mix can't clip.
+//Whole blocks are converted at once by the widest kernel the processor has (AVX2, SSE2 or plain C++),
+//it's picked once, when the first converter is made
+class PCMConverter {
+public:
+    static constexpr uint32_t maxChannels = 8;
+
+    struct Matrix {
+        uint32_t channels;
+        std::array<float, maxChannels> left;        //the scale of the samples is already in
+        std::array<float, maxChannels> right;
+    };
+
+    PCMConverter();
+
+    void setFormat(uint32_t channels, uint32_t bitsPerSample);
+    uint32_t getChannels() const;
+    uint32_t getOutputChannels() const;     //1 for mono, 2 for everything else
+    void convert(const int32_t* const input[], std::size_t offset, float* left, float* right, std::size_t frames) const;
+
+    static std::string_view kernelName();
+
+private:
+    using Kernel = void (*)(float scale, const int32_t* input, float* output, std::size_t frames);
+    using Downmix = void (*)(const Matrix& matrix, const int32_t* const input[], std::size_t offset, float* left, float* right, std::size_t frames);
+    struct Kernels {
+        std::string_view name;
+        Kernel kernel;
+        Downmix downmix;
+    };
+
+    static const Kernels& pickKernels();
+    static Matrix downmixMatrix(uint32_t channels, float scale);
+
+private:
+    uint32_t channels;
+    float scale;
+    Matrix matrix;
+    const Kernels& kernels;
+};
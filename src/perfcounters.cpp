@@ -0,0 +1,114 @@
+#include "perfcounters.h"
+
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+constexpr std::array<std::string_view, PerfCounters::_countersSize> counterNames({
+    "cycles",
+    "instructions",
+    "cacheMisses",
+    "branchMisses"
+});
+
+constexpr std::array<uint64_t, PerfCounters::_countersSize> events({
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+});
+
+namespace {
+    struct Group {
+        Group();
+        ~Group();
+
+        bool open();
+
+        bool tried;
+        std::array<int, PerfCounters::_countersSize> descriptors;
+    };
+
+    thread_local Group group;
+
+    Group::Group():
+        tried(false),
+        descriptors()
+    {
+        descriptors.fill(-1);
+    }
+
+    Group::~Group() {
+        for (int descriptor : descriptors)
+            if (descriptor != -1)
+                close(descriptor);
+    }
+
+    bool Group::open() {
+        tried = true;
+        for (std::size_t i = 0; i < events.size(); ++i) {
+            struct perf_event_attr attributes;
+            std::memset(&attributes, 0, sizeof(attributes));
+            attributes.size = sizeof(attributes);
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.config = events[i];
+            attributes.read_format = PERF_FORMAT_GROUP;
+            attributes.disabled = i == 0;       //the leader starts the whole group once it's complete
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+
+            int leader = i == 0 ? -1 : descriptors[0];
+            descriptors[i] = syscall(SYS_perf_event_open, &attributes, 0, -1, leader, 0);
+            if (descriptors[i] == -1)
+                return false;
+        }
+
+        return ioctl(descriptors[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) == 0;
+    }
+}
+
+std::atomic<bool> PerfCounters::enabled(false);
+
+bool PerfCounters::enable() {
+    if (!group.tried && !group.open())
+        return false;
+
+    if (group.descriptors.back() == -1)
+        return false;
+
+    enabled.store(true, std::memory_order_release);
+    return true;
+}
+
+bool PerfCounters::isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+PerfCounters::Values PerfCounters::read() {
+    Values result;
+    result.fill(0);
+    if (!isEnabled())
+        return result;
+
+    if (!group.tried)
+        group.open();
+
+    if (group.descriptors.back() == -1)
+        return result;
+
+    struct {
+        uint64_t count;
+        uint64_t values[_countersSize];
+    } buffer;
+    if (::read(group.descriptors[0], &buffer, sizeof(buffer)) != sizeof(buffer) || buffer.count != _countersSize)
+        return result;
+
+    std::copy(buffer.values, buffer.values + _countersSize, result.begin());
+    return result;
+}
+
+std::string_view PerfCounters::counterName(Counter counter) {
+    return counterNames[counter];
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string_view>
+#include <cstdint>
+
+//Hardware counters of the calling thread through perf_event_open.
+//Every thread opens its own group the first time it reads, the kernel only counts while the thread runs.
+//Only the user space is counted, so it works with the default perf_event_paranoid
+class PerfCounters {
+public:
+    enum Counter {
+        cycles,
+        instructions,
+        cacheMisses,
+        branchMisses,
+        _countersSize
+    };
+    using Values = std::array<uint64_t, _countersSize>;
+
+    static bool enable();           //false if the kernel or the machine doesn't let us count
+    static bool isEnabled();
+    static Values read();           //zeros if it's not enabled or the thread couldn't open its counters
+    static std::string_view counterName(Counter counter);
+
+private:
+    static std::atomic<bool> enabled;
+};
@@ -0,0 +1,57 @@
+#include "queuescheduler.h"
+
+QueueScheduler::QueueScheduler(unsigned int limit):
+    limit(limit),
+    terminate(false),
+    mutex(),
+    loopConditional(),
+    spaceConditional(),
+    jobs()
+{}
+
+void QueueScheduler::push(Job&& job) {
+    std::unique_lock lock(mutex);
+    while (limit != 0 && jobs.size() >= limit && !terminate)
+        spaceConditional.wait(lock);        //the producer waits, so that the queue doesn't grow with the library
+
+    jobs.push_back(std::move(job));
+    lock.unlock();
+    loopConditional.notify_one();
+}
+
+std::optional<Job> QueueScheduler::pop(unsigned int worker) {
+    (void)(worker);
+    std::unique_lock lock(mutex);
+    while (!terminate && jobs.empty())
+        loopConditional.wait(lock);
+
+    if (terminate)
+        return std::nullopt;
+
+    std::optional<Job> job(std::move(jobs.front()));
+    jobs.pop_front();
+    lock.unlock();
+    spaceConditional.notify_one();
+
+    return job;
+}
+
+std::vector<std::filesystem::path> QueueScheduler::upcoming(std::size_t count) {
+    std::vector<std::filesystem::path> result;
+    std::lock_guard lock(mutex);
+    for (std::deque<Job>::const_iterator itr = jobs.begin(); itr != jobs.end() && result.size() < count; ++itr) {
+        if (itr->type == Job::convert)
+            result.push_back(itr->source());
+    }
+
+    return result;
+}
+
+void QueueScheduler::stop() {
+    std::unique_lock lock(mutex);
+    terminate = true;
+    lock.unlock();
+
+    loopConditional.notify_all();
+    spaceConditional.notify_all();
+}
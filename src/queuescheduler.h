@@ -0,0 +1,26 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#include "scheduler.h"
+
+//One FIFO queue under one mutex, simple and fair
+class QueueScheduler : public Scheduler {
+public:
+    QueueScheduler(unsigned int limit);
+
+    void push(Job&& job) override;
+    std::optional<Job> pop(unsigned int worker) override;
+    std::vector<std::filesystem::path> upcoming(std::size_t count) override;
+    void stop() override;
+
+private:
+    const unsigned int limit;
+    bool terminate;
+    std::mutex mutex;
+    std::condition_variable loopConditional;
+    std::condition_variable spaceConditional;
+    std::deque<Job> jobs;
+};
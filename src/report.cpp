@@ -0,0 +1,305 @@
+#include "report.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+
+constexpr int reportVersion = 1;
+
+Report::Report(const std::string& path):
+    path(path),
+    mutex(),
+    records()
+{}
+
+const std::string& Report::getPath() const {
+    return path;
+}
+
+void Report::add(const Job& job, bool success, const Timing::Samples& stages, uint64_t elapsed, uint64_t resident) {
+    Record record;
+    record.source = job.source().string();
+    record.destination = job.destination().string();
+    record.directory = job.directory->source().string();
+    record.type = job.type;
+    record.success = success;
+    record.stages = stages;
+    record.elapsed = elapsed;
+    record.inputBytes = job.size;
+    record.outputBytes = 0;
+    record.duration = job.duration;
+    record.footprint = job.footprint;
+    record.resident = resident;
+    if (success) {
+        std::error_code ec;
+        uintmax_t size = std::filesystem::file_size(job.destination(), ec);
+        if (!ec)
+            record.outputBytes = size;
+    }
+
+    std::lock_guard lock(mutex);
+    records.push_back(std::move(record));
+}
+
+bool Report::write(double seconds) const {
+    std::ofstream stream(path, std::ios::out | std::ios::trunc);
+    if (!stream.is_open())
+        return false;
+
+    std::lock_guard lock(mutex);
+    unsigned int failed = std::count_if(records.begin(), records.end(), [] (const Record& record) {
+        return !record.success;
+    });
+
+    stream << std::setprecision(6) << std::fixed;
+    stream << "{\n";
+    stream << "  \"version\": " << reportVersion << ",\n";
+    stream << "  \"seconds\": " << seconds << ",\n";
+    stream << "  \"jobs\": " << records.size() << ",\n";
+    stream << "  \"failed\": " << failed << ",\n";
+    writeStages(stream);
+    writeRealtime(stream);
+    writeDirectories(stream);
+    stream << "  \"files\": [";
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        stream << (i == 0 ? "\n" : ",\n");
+        writeRecord(stream, records[i]);
+    }
+    stream << "\n  ]\n}\n";
+
+    stream.close();
+    return !stream.fail();
+}
+
+void Report::writeRecord(std::ostream& stream, const Record& record) const {
+    stream << "    {\"source\": " << quote(record.source)
+           << ", \"destination\": " << quote(record.destination)
+           << ", \"type\": " << (record.type == Job::convert ? "\"convert\"" : "\"copy\"")
+           << ", \"success\": " << (record.success ? "true" : "false")
+           << ", \"inputBytes\": " << record.inputBytes
+           << ", \"outputBytes\": " << record.outputBytes
+           << ", \"audio\": " << record.duration
+           << ", \"wall\": " << seconds(record.elapsed)
+           << ", \"cpu\": " << cpu(record.stages)
+           << ", \"realtimeFactor\": " << realtime(record)
+           << ", \"memory\": {\"estimate\": " << record.footprint << ", \"resident\": " << record.resident << "}"
+           << ", \"stages\": {";
+
+    for (std::size_t i = 0; i < Timing::_stagesSize; ++i) {
+        const Timing::Sample& sample = record.stages[i];
+        stream << (i == 0 ? "" : ", ") << quote(std::string(Timing::stageName(static_cast<Timing::Stage>(i))))
+               << ": {\"wall\": " << seconds(sample.wall) << ", \"cpu\": " << seconds(sample.cpu);
+        writeCounters(stream, sample);
+        stream << "}";
+    }
+    stream << "}}";
+}
+
+void Report::writeStages(std::ostream& stream) const {
+    Timing::Samples sums = totals();
+    stream << "  \"stages\": {\n";
+    for (std::size_t i = 0; i < Timing::_stagesSize; ++i) {
+        std::vector<double> wall;
+        std::vector<double> cpu;
+        for (const Record& record : records) {
+            wall.push_back(seconds(record.stages[i].wall));
+            cpu.push_back(seconds(record.stages[i].cpu));
+        }
+
+        stream << "    " << quote(std::string(Timing::stageName(static_cast<Timing::Stage>(i)))) << ": {\"wall\": ";
+        writePercentiles(stream, percentiles(wall));
+        stream << ", \"cpu\": ";
+        writePercentiles(stream, percentiles(cpu));
+        writeCounters(stream, sums[i]);     //ratios of the sums, so the long files weigh more
+        stream << (i + 1 == Timing::_stagesSize ? "}\n" : "},\n");
+    }
+    stream << "  },\n";
+}
+
+void Report::writeRealtime(std::ostream& stream) const {
+    std::vector<double> factors;
+    for (const Record& record : records)
+        if (record.type == Job::convert && record.success && record.duration > 0)
+            factors.push_back(realtime(record));
+
+    stream << "  \"realtimeFactor\": ";      //higher is faster, the slow files are at the low end
+    std::sort(factors.begin(), factors.end());
+    if (factors.empty()) {
+        stream << "null,\n";
+        return;
+    }
+
+    std::size_t last = factors.size() - 1;
+    stream << "{\"min\": " << factors.front()
+           << ", \"p1\": " << factors[last / 100]
+           << ", \"p10\": " << factors[last / 10]
+           << ", \"p50\": " << factors[last / 2]
+           << ", \"max\": " << factors.back() << "},\n";
+}
+
+void Report::writeDirectories(std::ostream& stream) const {
+    struct Totals {
+        unsigned int files;
+        double wall;
+        double cpu;
+        double audio;
+    };
+
+    std::map<std::string, Totals> directories;
+    for (const Record& record : records) {
+        Totals& totals = directories[record.directory];
+        ++totals.files;
+        totals.wall += seconds(record.elapsed);
+        totals.cpu += cpu(record.stages);
+        totals.audio += record.duration;
+    }
+
+    std::vector<std::pair<std::string, Totals>> sorted(directories.begin(), directories.end());
+    std::sort(sorted.begin(), sorted.end(), [] (const std::pair<std::string, Totals>& a, const std::pair<std::string, Totals>& b) {
+        return a.second.wall > b.second.wall;
+    });
+
+    stream << "  \"directories\": [";
+    for (std::size_t i = 0; i < sorted.size(); ++i) {
+        const Totals& totals = sorted[i].second;
+        stream << (i == 0 ? "\n" : ",\n")
+               << "    {\"path\": " << quote(sorted[i].first)
+               << ", \"files\": " << totals.files
+               << ", \"wall\": " << totals.wall
+               << ", \"cpu\": " << totals.cpu
+               << ", \"audio\": " << totals.audio
+               << ", \"realtimeFactor\": " << (totals.wall > 0 ? totals.audio / totals.wall : 0) << "}";
+    }
+    stream << "\n  ],\n";
+}
+
+Timing::Samples Report::totals() const {
+    Timing::Samples result;
+    for (Timing::Sample& sample : result)
+        sample = {0, 0, {}};
+
+    for (const Record& record : records) {
+        for (std::size_t i = 0; i < Timing::_stagesSize; ++i) {
+            result[i].wall += record.stages[i].wall;
+            result[i].cpu += record.stages[i].cpu;
+            for (std::size_t j = 0; j < PerfCounters::_countersSize; ++j)
+                result[i].counters[j] += record.stages[i].counters[j];
+        }
+    }
+
+    return result;
+}
+
+std::string Report::countersSummary() const {
+    std::lock_guard lock(mutex);
+    Timing::Samples sums = totals();
+    std::ostringstream result;
+    result << std::setprecision(2) << std::fixed;
+    for (std::size_t i = 0; i < Timing::_stagesSize; ++i) {
+        const Timing::Sample& sample = sums[i];
+        if (sample.counters[PerfCounters::cycles] == 0)
+            continue;
+
+        result << std::left << std::setw(10) << Timing::stageName(static_cast<Timing::Stage>(i)) << std::right
+               << ipc(sample) << " instructions per cycle, "
+               << perSecond(sample, PerfCounters::cacheMisses) / 1e6 << "M cache misses/s, "
+               << perSecond(sample, PerfCounters::branchMisses) / 1e6 << "M branch misses/s\n";
+    }
+
+    return result.str();
+}
+
+Report::Percentiles Report::percentiles(std::vector<double>& values) {
+    if (values.empty())
+        return {0, 0, 0, 0, 0};
+
+    std::sort(values.begin(), values.end());
+    Percentiles result;
+    result.total = 0;
+    for (double value : values)
+        result.total += value;
+
+    std::size_t last = values.size() - 1;
+    result.p50 = values[last * 50 / 100];
+    result.p90 = values[last * 90 / 100];
+    result.p99 = values[last * 99 / 100];
+    result.max = values.back();
+    return result;
+}
+
+void Report::writePercentiles(std::ostream& stream, const Percentiles& values) {
+    stream << "{\"total\": " << values.total
+           << ", \"p50\": " << values.p50
+           << ", \"p90\": " << values.p90
+           << ", \"p99\": " << values.p99
+           << ", \"max\": " << values.max << "}";
+}
+
+void Report::writeCounters(std::ostream& stream, const Timing::Sample& sample) {
+    if (!PerfCounters::isEnabled())
+        return;
+
+    for (std::size_t i = 0; i < PerfCounters::_countersSize; ++i)
+        stream << ", " << quote(std::string(PerfCounters::counterName(static_cast<PerfCounters::Counter>(i))))
+               << ": " << sample.counters[i];
+
+    stream << ", \"ipc\": " << ipc(sample)
+           << ", \"cacheMissesPerSecond\": " << perSecond(sample, PerfCounters::cacheMisses)
+           << ", \"branchMissesPerSecond\": " << perSecond(sample, PerfCounters::branchMisses);
+}
+
+double Report::ipc(const Timing::Sample& sample) {
+    uint64_t cycles = sample.counters[PerfCounters::cycles];
+    return cycles > 0 ? double(sample.counters[PerfCounters::instructions]) / cycles : 0;
+}
+
+double Report::perSecond(const Timing::Sample& sample, PerfCounters::Counter counter) {
+    return sample.cpu > 0 ? sample.counters[counter] / seconds(sample.cpu) : 0;       //per second of the CPU time, the counters stop when the thread sleeps
+}
+
+std::string Report::quote(const std::string& text) {
+    std::ostringstream result;
+    result << '"';
+    for (char ch : text) {
+        switch (ch) {
+            case '"':
+                result << "\\\"";
+                break;
+            case '\\':
+                result << "\\\\";
+                break;
+            case '\n':
+                result << "\\n";
+                break;
+            case '\t':
+                result << "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(ch) < 0x20)
+                    result << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(ch);
+                else
+                    result << ch;
+                break;
+        }
+    }
+    result << '"';
+    return result.str();
+}
+
+double Report::seconds(uint64_t nanoseconds) {
+    return nanoseconds / 1e9;
+}
+
+double Report::cpu(const Timing::Samples& stages) {
+    uint64_t result = 0;
+    for (const Timing::Sample& sample : stages)
+        result += sample.cpu;
+
+    return seconds(result);
+}
+
+double Report::realtime(const Record& record) {
+    return record.elapsed > 0 ? record.duration / seconds(record.elapsed) : 0;
+}
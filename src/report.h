@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <ostream>
+
+#include "job.h"
+#include "timing.h"
+
+//Collects what every job took and writes it as JSON:
+//a record for each file, percentiles for each stage and totals for each source directory.
+//With the hardware counters on every stage also gets its instructions per cycle and misses per second
+class Report {
+public:
+    struct Record {
+        std::string source;
+        std::string destination;
+        std::string directory;
+        Job::Type type;
+        bool success;
+        Timing::Samples stages;     //stages on different threads overlap, they add up to more than the elapsed time
+        uint64_t elapsed;           //nanoseconds from the start of the job to its end, the queue is not counted
+        uint64_t inputBytes;
+        uint64_t outputBytes;
+        double duration;        //seconds of audio, 0 for copies
+        uint64_t footprint;     //bytes the memory budget was charged for the job
+        uint64_t resident;      //resident size of the whole process at the end of the job, 0 if it wasn't read
+    };
+
+    Report(const std::string& path);
+
+    void add(const Job& job, bool success, const Timing::Samples& stages, uint64_t elapsed, uint64_t resident);
+    bool write(double seconds) const;
+    std::string countersSummary() const;        //a line for every stage that has counted anything
+    const std::string& getPath() const;
+
+    static std::string quote(const std::string& text);      //as a JSON string
+
+private:
+    struct Percentiles {
+        double total;
+        double p50;
+        double p90;
+        double p99;
+        double max;
+    };
+
+    void writeRecord(std::ostream& stream, const Record& record) const;
+    void writeStages(std::ostream& stream) const;
+    void writeRealtime(std::ostream& stream) const;
+    void writeDirectories(std::ostream& stream) const;
+    Timing::Samples totals() const;
+
+    static Percentiles percentiles(std::vector<double>& values);
+    static void writePercentiles(std::ostream& stream, const Percentiles& values);
+    static void writeCounters(std::ostream& stream, const Timing::Sample& sample);
+    static double ipc(const Timing::Sample& sample);
+    static double perSecond(const Timing::Sample& sample, PerfCounters::Counter counter);
+    static double seconds(uint64_t nanoseconds);
+    static double cpu(const Timing::Samples& stages);
+    static double realtime(const Record& record);
+
+private:
+    const std::string path;
+    mutable std::mutex mutex;
+    std::vector<Record> records;
+};
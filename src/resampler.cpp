@@ -0,0 +1,231 @@
+#include "resampler.h"
+
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MLC_X86
+#endif
+
+constexpr uint32_t lobes = 32;              //zero crossings of the sinc on each side, at the narrower of the two rates
+constexpr double rolloff = 0.95;            //of the lower Nyquist frequency, where the response is down by 6 dB
+constexpr double kaiserBeta = 9.0;          //about 90 dB of stopband
+constexpr std::size_t compactAfter = 1 << 14;       //frames the buffers may keep before they are moved back to the front
+
+namespace {
+    float dotScalar(const float* taps, const float* samples, std::size_t count) {
+        float result = 0;
+        for (std::size_t i = 0; i < count; ++i)
+            result += taps[i] * samples[i];
+
+        return result;
+    }
+
+#ifdef MLC_X86
+    __attribute__((target("sse2")))
+    float dotSSE2(const float* taps, const float* samples, std::size_t count) {
+        __m128 first = _mm_setzero_ps();
+        __m128 second = _mm_setzero_ps();
+        for (std::size_t i = 0; i < count; i += 8) {       //two sums, so the additions don't wait for each other
+            first = _mm_add_ps(first, _mm_mul_ps(_mm_loadu_ps(taps + i), _mm_loadu_ps(samples + i)));
+            second = _mm_add_ps(second, _mm_mul_ps(_mm_loadu_ps(taps + i + 4), _mm_loadu_ps(samples + i + 4)));
+        }
+
+        __m128 sum = _mm_add_ps(first, second);
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        return _mm_cvtss_f32(sum);
+    }
+
+    __attribute__((target("avx2")))
+    float dotAVX2(const float* taps, const float* samples, std::size_t count) {
+        __m256 sum = _mm256_setzero_ps();
+        for (std::size_t i = 0; i < count; i += 8)
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(taps + i), _mm256_loadu_ps(samples + i)));
+
+        __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+        return _mm_cvtss_f32(half);
+    }
+#endif
+
+    double besselI0(double x) {
+        double result = 1;
+        double term = 1;
+        for (int k = 1; k < 50 && term > result * 1e-12; ++k) {
+            term *= (x / (2 * k)) * (x / (2 * k));
+            result += term;
+        }
+        return result;
+    }
+}
+
+Resampler::Resampler():
+    filter(),
+    channels(0),
+    buffers(),
+    filled(0),
+    offset(0),
+    phase(0),
+    pushed(0),
+    pulled(0),
+    draining(false),
+    kernels(pickKernels())
+{}
+
+bool Resampler::setRates(uint32_t input, uint32_t output, uint32_t channels) {
+    if (input == 0 || output == 0 || input == output) {
+        filter.reset();
+        return false;
+    }
+
+    filter = table(input, output);
+    Resampler::channels = std::clamp(channels, 1u, maxChannels);
+    filled = filter->taps / 2 - 1;      //silence before the first sample, so the first output is centered on it
+    offset = 0;
+    phase = 0;
+    pushed = 0;
+    pulled = 0;
+    draining = false;
+    for (std::vector<float>& buffer : buffers)
+        buffer.assign(filled, 0);
+
+    return true;
+}
+
+bool Resampler::isActive() const {
+    return filter != nullptr;
+}
+
+std::array<float*, Resampler::maxChannels> Resampler::prepare(std::size_t frames) {
+    std::array<float*, maxChannels> result({nullptr, nullptr});
+    for (uint32_t channel = 0; channel < channels; ++channel) {
+        std::vector<float>& buffer = buffers[channel];
+        if (buffer.size() < filled + frames)
+            buffer.resize(filled + frames);
+
+        result[channel] = buffer.data() + filled;
+    }
+
+    return result;
+}
+
+void Resampler::push(std::size_t frames) {
+    filled += frames;
+    pushed += frames;
+}
+
+std::size_t Resampler::pull(float* left, float* right, std::size_t frames) {
+    const Table& table = *filter;
+    uint64_t limit = draining ? (pushed * table.up + table.down - 1) / table.down : UINT64_MAX;
+    std::array<float*, maxChannels> outputs({left, right});
+    std::size_t result = 0;
+    while (result < frames && pulled < limit && offset + table.taps <= filled) {
+        const float* taps = table.phases.data() + std::size_t(phase) * table.taps;
+        for (uint32_t channel = 0; channel < channels; ++channel)
+            outputs[channel][result] = kernels.kernel(taps, buffers[channel].data() + offset, table.taps);
+
+        ++result;
+        ++pulled;
+        phase += table.down;
+        offset += phase / table.up;
+        phase %= table.up;
+    }
+
+    if (offset >= compactAfter)
+        compact();
+
+    return result;
+}
+
+void Resampler::drain() {
+    if (draining)
+        return;
+
+    std::size_t tail = filter->taps / 2;        //silence after the last sample, for the last outputs to be centered on it
+    std::array<float*, maxChannels> silence = prepare(tail);
+    for (uint32_t channel = 0; channel < channels; ++channel)
+        std::fill(silence[channel], silence[channel] + tail, 0);
+
+    filled += tail;
+    draining = true;
+}
+
+void Resampler::compact() {
+    std::size_t keep = filled - std::min(offset, filled);
+    for (uint32_t channel = 0; channel < channels; ++channel)
+        std::copy(buffers[channel].begin() + offset, buffers[channel].begin() + offset + keep, buffers[channel].begin());
+
+    filled = keep;
+    offset = 0;
+}
+
+std::shared_ptr<const Resampler::Table> Resampler::table(uint32_t input, uint32_t output) {
+    static std::mutex mutex;
+    static std::map<std::pair<uint32_t, uint32_t>, std::shared_ptr<const Table>> tables;
+
+    std::lock_guard lock(mutex);
+    std::shared_ptr<const Table>& result = tables[{input, output}];
+    if (!result)
+        result = design(input, output);
+
+    return result;
+}
+
+std::shared_ptr<const Resampler::Table> Resampler::design(uint32_t input, uint32_t output) {
+    std::shared_ptr<Table> result = std::make_shared<Table>();
+    uint32_t divisor = std::gcd(input, output);
+    result->up = output / divisor;
+    result->down = input / divisor;
+
+    double ratio = std::min(1.0, double(output) / input);      //below 1 the input has to lose what the output can't hold
+    uint32_t width = uint32_t(std::ceil(lobes / ratio));       //input samples on each side
+    result->taps = (width * 2 + 7) / 8 * 8;
+    result->phases.resize(std::size_t(result->up) * result->taps);
+
+    double cutoff = 0.5 * ratio * rolloff;      //in cycles per input sample
+    double half = result->taps / 2.0;
+    double normalization = besselI0(kaiserBeta);
+    for (uint32_t p = 0; p < result->up; ++p) {
+        float* taps = result->phases.data() + std::size_t(p) * result->taps;
+        double sum = 0;
+        for (uint32_t k = 0; k < result->taps; ++k) {
+            double t = double(p) / result->up - (double(k) - half + 1);     //from the input sample to the output one
+            double x = 2 * cutoff * t;
+            double sinc = t == 0 ? 1 : std::sin(M_PI * x) / (M_PI * x);
+            double position = t / half;
+            double window = std::abs(position) >= 1 ? 0 : besselI0(kaiserBeta * std::sqrt(1 - position * position)) / normalization;
+            taps[k] = sinc * window;
+            sum += taps[k];
+        }
+
+        for (uint32_t k = 0; k < result->taps; ++k)     //every phase passes the DC as it is
+            taps[k] /= sum;
+    }
+
+    return result;
+}
+
+const Resampler::Kernels& Resampler::pickKernels() {
+    static const Kernels kernels = [] () -> Kernels {
+#ifdef MLC_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return {"AVX2", dotAVX2};
+        if (__builtin_cpu_supports("sse2"))
+            return {"SSE2", dotSSE2};
+#endif
+        return {"scalar", dotScalar};
+    }();
+
+    return kernels;
+}
+
+std::string_view Resampler::kernelName() {
+    return pickKernels().name;
+}
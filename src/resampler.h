@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+//Polyphase resampler between the decoder and the encoder, so LAME gets the audio at the rate it encodes.
+//The ratio of the rates is reduced to up / down, and every output sample is one dot product
+//of the input around it with one of up precomputed phases of a Kaiser windowed sinc.
+//The phases depend only on the pair of rates, they are computed once and shared by every file with the same pair.
+//The output starts at the first input sample, the delay of the filter is taken out,
+//and after drain() it ends where the input ends
+class Resampler {
+public:
+    static constexpr uint32_t maxChannels = 2;
+
+    Resampler();
+
+    bool setRates(uint32_t input, uint32_t output, uint32_t channels);    //false if there is nothing to do
+    bool isActive() const;
+    std::array<float*, maxChannels> prepare(std::size_t frames);          //where to put the next frames of input
+    void push(std::size_t frames);
+    std::size_t pull(float* left, float* right, std::size_t frames);      //returns how many it has written
+    void drain();                   //no more input, the last samples can come out
+
+    static std::string_view kernelName();
+
+private:
+    struct Table {
+        uint32_t up;
+        uint32_t down;
+        uint32_t taps;              //per phase, a multiple of 8, so the kernels don't have a tail
+        std::vector<float> phases;  //up × taps
+    };
+    using Kernel = float (*)(const float* taps, const float* samples, std::size_t count);
+    struct Kernels {
+        std::string_view name;
+        Kernel kernel;
+    };
+
+    void compact();
+
+    static std::shared_ptr<const Table> table(uint32_t input, uint32_t output);
+    static std::shared_ptr<const Table> design(uint32_t input, uint32_t output);
+    static const Kernels& pickKernels();
+
+private:
+    std::shared_ptr<const Table> filter;
+    uint32_t channels;
+    std::array<std::vector<float>, maxChannels> buffers;
+    std::size_t filled;         //frames in the buffers
+    std::size_t offset;         //first frame of the window of the next output
+    uint32_t phase;
+    uint64_t pushed;            //frames of input since the start
+    uint64_t pulled;            //frames of output since the start
+    bool draining;
+    const Kernels& kernels;
+};
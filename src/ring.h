@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <cstddef>
+#include <cstdint>
+
+//Bounded lock-free multi producer multi consumer queue (Dmitry Vyukov's design).
+//Every cell carries a sequence number that tells whose turn it is:
+//producers wait for it to equal their position, consumers for position + 1
+template <typename T>
+class Ring {
+public:
+    explicit Ring(std::size_t capacity);
+
+    bool push(T&& value);
+    std::optional<T> pop();
+    std::size_t capacity() const;
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        std::optional<T> value;
+    };
+
+    static std::size_t roundUp(std::size_t capacity);
+
+private:
+    const std::size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<std::size_t> pushPosition;
+    alignas(64) std::atomic<std::size_t> popPosition;
+};
+
+template <typename T>
+Ring<T>::Ring(std::size_t capacity):
+    mask(roundUp(capacity) - 1),
+    cells(new Cell[mask + 1]),
+    pushPosition(0),
+    popPosition(0)
+{
+    for (std::size_t i = 0; i <= mask; ++i)
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template <typename T>
+bool Ring<T>::push(T&& value) {
+    std::size_t position = pushPosition.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position & mask];
+        std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+        if (difference == 0) {
+            if (pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (difference < 0) {
+            return false;       //full
+        } else {
+            position = pushPosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->value.emplace(std::move(value));
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+std::optional<T> Ring<T>::pop() {
+    std::size_t position = popPosition.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position & mask];
+        std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+        if (difference == 0) {
+            if (popPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (difference < 0) {
+            return std::nullopt;    //empty
+        } else {
+            position = popPosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::optional<T> result(std::move(cell->value));
+    cell->value.reset();
+    cell->sequence.store(position + mask + 1, std::memory_order_release);
+    return result;
+}
+
+template <typename T>
+std::size_t Ring<T>::capacity() const {
+    return mask + 1;
+}
+
+template <typename T>
+std::size_t Ring<T>::roundUp(std::size_t capacity) {
+    std::size_t result = 2;
+    while (result < capacity)
+        result <<= 1;
+
+    return result;
+}
@@ -0,0 +1,10 @@
+#include "scheduler.h"
+
+Scheduler::~Scheduler() {}
+
+void Scheduler::finishPushing() {}
+
+std::vector<std::filesystem::path> Scheduler::upcoming(std::size_t count) {
+    (void)(count);
+    return {};
+}
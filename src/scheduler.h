@@ -0,0 +1,22 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+#include <filesystem>
+
+#include "job.h"
+
+//Decides which worker runs which job and in what order.
+//push blocks when the scheduler is full, pop blocks until there is a job or the scheduler is stopped,
+//finishPushing tells that the scan is over and nothing else is going to be pushed,
+//upcoming guesses the sources of the conversions that are going to be given out next, so they can be read ahead
+class Scheduler {
+public:
+    virtual ~Scheduler();
+
+    virtual void push(Job&& job) = 0;
+    virtual std::optional<Job> pop(unsigned int worker) = 0;
+    virtual void finishPushing();
+    virtual std::vector<std::filesystem::path> upcoming(std::size_t count);
+    virtual void stop() = 0;
+};
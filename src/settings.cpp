@@ -7,6 +7,9 @@ static const char* defaultConfig =
 enum class Flag {
     config,
     help,
+    report,
+    trace,
+    perfCounters,
     none
 };
 
@@ -21,13 +24,29 @@ enum class Option {
     encodingQuality,
     outputQuality,
     vbr,
+    incremental,
+    scanThreads,
+    queueLimit,
+    scheduler,
+    splitLongerThan,
+    pipeline,
+    memoryBudget,
+    copyThreads,
+    copyMode,
+    sampleRate,
+    resampler,
+    readahead,
+    ioBackend,
     _optionsSize
 };
 
 using Literals = std::array<std::string_view, 2>;
 constexpr std::array<Literals, static_cast<int>(Flag::none)> flags({{
     {"-c", "--config"},
-    {"-h", "--help"}
+    {"-h", "--help"},
+    {"-r", "--report"},
+    {"-t", "--trace"},
+    {"-p", "--perf-counters"}
 }});
 
 constexpr std::array<std::string_view, Settings::_actionsSize> actions({
@@ -46,13 +65,53 @@ constexpr std::array<std::string_view, static_cast<int>(Option::_optionsSize)> o
     "exclude",
     "encodingQuality",
     "outputQuality",
-    "vbr"
+    "vbr",
+    "incremental",
+    "scanThreads",
+    "queueLimit",
+    "scheduler",
+    "splitLongerThan",
+    "pipeline",
+    "memoryBudget",
+    "copyThreads",
+    "copyMode",
+    "sampleRate",
+    "resampler",
+    "readahead",
+    "ioBackend"
 });
 
 constexpr std::array<std::string_view, Settings::_typesSize> types({
     "mp3"
 });
 
+constexpr std::array<std::string_view, Settings::_schedulingsSize> schedulings({
+    "queue",
+    "stealing",
+    "longest"
+});
+
+constexpr std::array<std::string_view, Settings::_copyModesSize> copyModes({
+    "automatic",
+    "reflink",
+    "range",
+    "hardlink",
+    "symlink",
+    "plain"
+});
+
+constexpr std::array<std::string_view, Settings::_resamplingsSize> resamplings({
+    "polyphase",
+    "lame"
+});
+
+constexpr std::array<std::string_view, Settings::_ioBackendsSize> ioBackends({
+    "blocking",
+    "uring"
+});
+
+constexpr std::array<unsigned int, 9> mp3SampleRates({8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000});
+
 constexpr unsigned int maxQuality = 9;
 constexpr unsigned int minQuality = 0;
 
@@ -87,11 +146,27 @@ Settings::Settings(int argc, char ** argv):
     output(std::nullopt),
     logLevel(std::nullopt),
     configPath(std::nullopt),
+    reportPath(std::nullopt),
+    tracePath(std::nullopt),
+    perfCounting(std::nullopt),
     threads(std::nullopt),
+    scanThreads(std::nullopt),
+    queueLimit(std::nullopt),
+    scheduling(std::nullopt),
     nonMusic(std::nullopt),
     encodingQuality(std::nullopt),
     outputQuality(std::nullopt),
-    vbr(std::nullopt)
+    vbr(std::nullopt),
+    incremental(std::nullopt),
+    splitLongerThan(std::nullopt),
+    pipeline(std::nullopt),
+    memoryBudget(std::nullopt),
+    copyThreads(std::nullopt),
+    copyMode(std::nullopt),
+    sampleRate(std::nullopt),
+    resampling(std::nullopt),
+    readahead(std::nullopt),
+    ioBackend(std::nullopt)
 {
     for (int i = 1; i < argc; ++i)
         arguments.push_back(argv[i]);
@@ -116,6 +191,14 @@ void Settings::parseArguments() {
                 configPath = arg;
                 flag = Flag::none;
                 continue;
+            case Flag::report:
+                reportPath = arg;
+                flag = Flag::none;
+                continue;
+            case Flag::trace:
+                tracePath = arg;
+                flag = Flag::none;
+                continue;
             case Flag::none:
                 flag = getFlag(arg);
                 break;
@@ -130,6 +213,10 @@ void Settings::parseArguments() {
                 action = help;
                 flag = Flag::none;
                 continue;
+            case Flag::perfCounters:
+                perfCounting = true;
+                flag = Flag::none;
+                continue;
             default:
                 continue;
         }
@@ -183,6 +270,27 @@ std::string Settings::getConfigPath() const {
         return resolvePath("~/.config/mlc.conf");
 }
 
+std::string Settings::getReportPath() const {
+    if (reportPath.has_value())
+        return resolvePath(reportPath.value());
+    else
+        return "";
+}
+
+std::string Settings::getTracePath() const {
+    if (tracePath.has_value())
+        return resolvePath(tracePath.value());
+    else
+        return "";
+}
+
+bool Settings::isPerfCounting() const {
+    if (perfCounting.has_value())
+        return perfCounting.value();
+    else
+        return false;
+}
+
 bool Settings::isConfigDefault() const {
     return !configPath.has_value();
 }
@@ -201,6 +309,92 @@ unsigned int Settings::getThreads() const {
         return 0;
 }
 
+unsigned int Settings::getCopyThreads() const {
+    if (copyThreads.has_value())
+        return copyThreads.value();
+    else if (getScheduling() == longest)
+        return 0;       //the encoding threads idle until the scan is over, the copies fill that gap
+    else
+        return 2;
+}
+
+unsigned int Settings::getSampleRate() const {
+    if (sampleRate.has_value())
+        return sampleRate.value();
+    else
+        return 0;
+}
+
+Settings::Resampling Settings::getResampling() const {
+    if (resampling.has_value())
+        return resampling.value();
+    else
+        return lame;
+}
+
+unsigned int Settings::getReadahead() const {
+    if (readahead.has_value())
+        return readahead.value();
+    else
+        return 2;
+}
+
+Settings::IOBackend Settings::getIOBackend() const {
+    if (ioBackend.has_value())
+        return ioBackend.value();
+    else
+        return blocking;
+}
+
+Settings::CopyMode Settings::getCopyMode() const {
+    if (copyMode.has_value())
+        return copyMode.value();
+    else
+        return automatic;
+}
+
+unsigned int Settings::getScanThreads() const {
+    if (scanThreads.has_value())
+        return scanThreads.value();
+    else
+        return 4;
+}
+
+unsigned int Settings::getQueueLimit() const {
+    if (queueLimit.has_value())
+        return queueLimit.value();
+    else
+        return 4096;
+}
+
+unsigned int Settings::getMemoryBudget() const {
+    if (memoryBudget.has_value())
+        return memoryBudget.value();
+    else
+        return 0;
+}
+
+bool Settings::isPipelined() const {
+    if (pipeline.has_value())
+        return pipeline.value();
+    else
+        return false;
+}
+
+unsigned int Settings::getSplitLongerThan() const {
+    if (splitLongerThan.has_value())
+        return splitLongerThan.value();
+    else
+        return 0;
+}
+
+Settings::Scheduling Settings::getScheduling() const {
+    if (scheduling.has_value())
+        return scheduling.value();
+    else
+        return queue;
+}
+
 unsigned char Settings::getOutputQuality() const {
     if (outputQuality.has_value())
         return outputQuality.value();
@@ -222,6 +416,13 @@ bool Settings::getVBR() const {
         return true;
 }
 
+bool Settings::isIncremental() const {
+    if (incremental.has_value())
+        return incremental.value();
+    else
+        return true;
+}
+
 void Settings::strip(std::string& line) {
     line.erase(line.begin(), std::find_if(line.begin(), line.end(), std::not_fn(is_space)));
     line.erase(std::find_if(line.rbegin(), line.rend(), std::not_fn(is_space)).base(), line.end());
@@ -306,6 +507,82 @@ void Settings::readConfigLine(const std::string& line) {
             if (!threads.has_value() && std::istringstream(value) >> count)
                 threads = count;
         }   break;
+        case Option::scanThreads: {
+            unsigned int count;
+            if (!scanThreads.has_value() && std::istringstream(value) >> count) {
+                if (count > 0)      //someone has to scan, 0 is ignored like any other invalid value
+                    scanThreads = count;
+            }
+        }   break;
+        case Option::copyThreads: {
+            unsigned int count;
+            if (!copyThreads.has_value() && std::istringstream(value) >> count)
+                copyThreads = count;
+        }   break;
+        case Option::copyMode: {
+            std::string md;
+            if (!copyMode.has_value() && std::istringstream(value) >> md) {
+                CopyMode mode = stringToCopyMode(md);
+                if (mode < _copyModesSize)
+                    copyMode = mode;
+            }
+        }   break;
+        case Option::sampleRate: {
+            unsigned int rate;
+            if (!sampleRate.has_value() && std::istringstream(value) >> rate) {
+                if (rate == 0 || std::find(mp3SampleRates.begin(), mp3SampleRates.end(), rate) != mp3SampleRates.end())
+                    sampleRate = rate;
+            }
+        }   break;
+        case Option::resampler: {
+            std::string rs;
+            if (!resampling.has_value() && std::istringstream(value) >> rs) {
+                Resampling res = stringToResampling(rs);
+                if (res < _resamplingsSize)
+                    resampling = res;
+            }
+        }   break;
+        case Option::readahead: {
+            unsigned int count;
+            if (!readahead.has_value() && std::istringstream(value) >> count)
+                readahead = count;
+        }   break;
+        case Option::ioBackend: {
+            std::string io;
+            if (!ioBackend.has_value() && std::istringstream(value) >> io) {
+                IOBackend backend = stringToIOBackend(io);
+                if (backend < _ioBackendsSize)
+                    ioBackend = backend;
+            }
+        }   break;
+        case Option::queueLimit: {
+            unsigned int count;
+            if (!queueLimit.has_value() && std::istringstream(value) >> count)
+                queueLimit = count;
+        }   break;
+        case Option::scheduler: {
+            std::string sc;
+            if (!scheduling.has_value() && std::istringstream(value) >> sc) {
+                Scheduling sched = stringToScheduling(sc);
+                if (sched < _schedulingsSize)
+                    scheduling = sched;
+            }
+        }   break;
+        case Option::splitLongerThan: {
+            unsigned int seconds;
+            if (!splitLongerThan.has_value() && std::istringstream(value) >> seconds)
+                splitLongerThan = seconds;
+        }   break;
+        case Option::pipeline: {
+            bool pipe;
+            if (!pipeline.has_value() && std::istringstream(value) >> std::boolalpha >> pipe)
+                pipeline = pipe;
+        }   break;
+        case Option::memoryBudget: {
+            unsigned int mebibytes;
+            if (!memoryBudget.has_value() && std::istringstream(value) >> mebibytes)
+                memoryBudget = mebibytes;
+        }   break;
         case Option::filesToCopy: {
             if (!nonMusic.has_value()) {
                 if (value == "all")
@@ -335,6 +612,11 @@ void Settings::readConfigLine(const std::string& line) {
             if (!vbr.has_value() && std::istringstream(value) >> std::boolalpha >> vb)
                 vbr = vb;
         }   break;
+        case Option::incremental: {
+            bool inc;
+            if (!incremental.has_value() && std::istringstream(value) >> std::boolalpha >> inc)
+                incremental = inc;
+        }   break;
         default:
             break;
     }
@@ -364,6 +646,38 @@ Settings::Type Settings::stringToType(const std::string& source) {
     return _typesSize;
 }
 
+Settings::Scheduling Settings::stringToScheduling(const std::string& source) {
+    unsigned char dist = std::distance(schedulings.begin(), std::find(schedulings.begin(), schedulings.end(), source));
+    if (dist < _schedulingsSize)
+        return static_cast<Scheduling>(dist);
+
+    return _schedulingsSize;
+}
+
+Settings::CopyMode Settings::stringToCopyMode(const std::string& source) {
+    unsigned char dist = std::distance(copyModes.begin(), std::find(copyModes.begin(), copyModes.end(), source));
+    if (dist < _copyModesSize)
+        return static_cast<CopyMode>(dist);
+
+    return _copyModesSize;
+}
+
+Settings::Resampling Settings::stringToResampling(const std::string& source) {
+    unsigned char dist = std::distance(resamplings.begin(), std::find(resamplings.begin(), resamplings.end(), source));
+    if (dist < _resamplingsSize)
+        return static_cast<Resampling>(dist);
+
+    return _resamplingsSize;
+}
+
+Settings::IOBackend Settings::stringToIOBackend(const std::string& source) {
+    unsigned char dist = std::distance(ioBackends.begin(), std::find(ioBackends.begin(), ioBackends.end(), source));
+    if (dist < _ioBackendsSize)
+        return static_cast<IOBackend>(dist);
+
+    return _ioBackendsSize;
+}
+
 std::string Settings::resolvePath(const std::string& line) {
     if (line.size() > 0 && line[0] == '~')
         return getenv("HOME") + line.substr(1);
@@ -29,21 +29,66 @@ public:
         _typesSize
     };
 
+    enum Scheduling {
+        queue,
+        stealing,
+        longest,
+        _schedulingsSize
+    };
+
+    enum CopyMode {
+        automatic,
+        reflink,
+        range,
+        hardlink,
+        symlink,
+        plain,
+        _copyModesSize
+    };
+
+    enum Resampling {
+        polyphase,
+        lame,
+        _resamplingsSize
+    };
+
+    enum IOBackend {
+        blocking,
+        uring,
+        _ioBackendsSize
+    };
+
     Settings(int argc, char **argv);
 
     std::string getInput() const;
     std::string getOutput() const;
     std::string getConfigPath() const;
     bool isConfigDefault() const;
+    std::string getReportPath() const;
+    std::string getTracePath() const;
+    bool isPerfCounting() const;
     Logger::Severity getLogLevel() const;
     Type getType() const;
     Action getAction() const;
     unsigned int getThreads() const;
+    unsigned int getScanThreads() const;
+    unsigned int getCopyThreads() const;
+    CopyMode getCopyMode() const;
+    unsigned int getQueueLimit() const;
+    Scheduling getScheduling() const;
+    unsigned int getSplitLongerThan() const;
+    bool isPipelined() const;
+    unsigned int getSampleRate() const;
+    Resampling getResampling() const;
+    unsigned int getReadahead() const;
+    IOBackend getIOBackend() const;
+    unsigned int getMemoryBudget() const;
     bool matchNonMusic(const std::string& fileName) const;
     bool isExcluded(const std::string& path) const;
     unsigned char getEncodingQuality() const;
     unsigned char getOutputQuality() const;
     bool getVBR() const;
+    bool isIncremental() const;
 
     bool readConfigFile();
     void readConfigLine(const std::string& line);
@@ -52,6 +97,10 @@ public:
     static Action stringToAction(const std::string& source);
     static Action stringToAction(const std::string_view& source);
     static Type stringToType(const std::string& source);
+    static Scheduling stringToScheduling(const std::string& source);
+    static CopyMode stringToCopyMode(const std::string& source);
+    static Resampling stringToResampling(const std::string& source);
+    static IOBackend stringToIOBackend(const std::string& source);
 
 private:
     void parseArguments();
@@ -68,10 +117,26 @@ private:
     std::optional<std::string> output;
     std::optional<Logger::Severity> logLevel;
     std::optional<std::string> configPath;
+    std::optional<std::string> reportPath;
+    std::optional<std::string> tracePath;
+    std::optional<bool> perfCounting;
     std::optional<unsigned int> threads;
+    std::optional<unsigned int> scanThreads;
+    std::optional<unsigned int> queueLimit;
+    std::optional<Scheduling> scheduling;
     std::optional<std::regex> nonMusic;
     std::optional<std::regex> excluded;
     std::optional<unsigned char> encodingQuality;
     std::optional<unsigned char> outputQuality;
     std::optional<bool> vbr;
+    std::optional<bool> incremental;
+    std::optional<unsigned int> splitLongerThan;
+    std::optional<bool> pipeline;
+    std::optional<unsigned int> memoryBudget;
+    std::optional<unsigned int> copyThreads;
+    std::optional<CopyMode> copyMode;
+    std::optional<unsigned int> sampleRate;
+    std::optional<Resampling> resampling;
+    std::optional<unsigned int> readahead;
+    std::optional<IOBackend> ioBackend;
 };
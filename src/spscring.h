@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+//Bounded single producer single consumer queue that connects two stages of one conversion.
+//Each side owns one position, so the fast path is a load and a store without any CAS.
+//A side that has to wait (full for the producer, empty for the consumer) parks on a condition variable,
+//the other side only takes the mutex if it sees someone parked
+template <typename T>
+class SPSCRing {
+public:
+    explicit SPSCRing(std::size_t capacity);
+
+    bool push(T&& value);           //waits while full, false if the ring is closed
+    bool tryPush(T&& value);        //false if full or closed, the value stays untouched then
+    std::optional<T> pop();         //waits while empty, nullopt once it's closed and drained
+    std::optional<T> tryPop();
+    void close();                   //either side can close, the other one wakes up
+
+private:
+    bool full(std::size_t position) const;
+    bool empty(std::size_t position) const;
+    void wake();
+
+    static std::size_t roundUp(std::size_t capacity);
+
+private:
+    const std::size_t mask;
+    std::unique_ptr<std::optional<T>[]> cells;
+    alignas(64) std::atomic<std::size_t> head;      //next to pop, written by the consumer only
+    alignas(64) std::atomic<std::size_t> tail;      //next to push, written by the producer only
+    alignas(64) std::atomic<bool> closed;
+    std::atomic<unsigned int> parked;   //a counter, both sides can be on their way to park at the same time
+    std::mutex mutex;
+    std::condition_variable conditional;
+};
+
+template <typename T>
+SPSCRing<T>::SPSCRing(std::size_t capacity):
+    mask(roundUp(capacity) - 1),
+    cells(new std::optional<T>[mask + 1]),
+    head(0),
+    tail(0),
+    closed(false),
+    parked(0),
+    mutex(),
+    conditional()
+{}
+
+template <typename T>
+bool SPSCRing<T>::push(T&& value) {
+    std::size_t position = tail.load(std::memory_order_relaxed);
+    if (full(position)) {
+        std::unique_lock lock(mutex);
+        parked.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (full(position) && !closed.load(std::memory_order_seq_cst))
+            conditional.wait(lock);
+
+        parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    if (closed.load(std::memory_order_acquire))
+        return false;
+
+    cells[position & mask].emplace(std::move(value));
+    tail.store(position + 1, std::memory_order_release);
+    wake();
+    return true;
+}
+
+template <typename T>
+bool SPSCRing<T>::tryPush(T&& value) {
+    std::size_t position = tail.load(std::memory_order_relaxed);
+    if (full(position) || closed.load(std::memory_order_acquire))
+        return false;
+
+    cells[position & mask].emplace(std::move(value));
+    tail.store(position + 1, std::memory_order_release);
+    wake();
+    return true;
+}
+
+template <typename T>
+std::optional<T> SPSCRing<T>::pop() {
+    std::size_t position = head.load(std::memory_order_relaxed);
+    if (empty(position)) {
+        std::unique_lock lock(mutex);
+        parked.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (empty(position) && !closed.load(std::memory_order_seq_cst))
+            conditional.wait(lock);
+
+        parked.fetch_sub(1, std::memory_order_relaxed);
+        if (empty(position))
+            return std::nullopt;    //closed and there is nothing left
+    }
+
+    return tryPop();
+}
+
+template <typename T>
+std::optional<T> SPSCRing<T>::tryPop() {
+    std::size_t position = head.load(std::memory_order_relaxed);
+    if (empty(position))
+        return std::nullopt;
+
+    std::optional<T> result(std::move(cells[position & mask]));
+    cells[position & mask].reset();
+    head.store(position + 1, std::memory_order_release);
+    wake();
+    return result;
+}
+
+template <typename T>
+void SPSCRing<T>::close() {
+    std::lock_guard lock(mutex);
+    closed.store(true, std::memory_order_seq_cst);
+    conditional.notify_all();
+}
+
+template <typename T>
+bool SPSCRing<T>::full(std::size_t position) const {
+    return position - head.load(std::memory_order_acquire) > mask;
+}
+
+template <typename T>
+bool SPSCRing<T>::empty(std::size_t position) const {
+    return tail.load(std::memory_order_acquire) == position;
+}
+
+template <typename T>
+void SPSCRing<T>::wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);    //pairs with the increment of parked, so no wake up is missed
+    if (parked.load(std::memory_order_relaxed) != 0) {
+        std::lock_guard lock(mutex);
+        conditional.notify_all();
+    }
+}
+
+template <typename T>
+std::size_t SPSCRing<T>::roundUp(std::size_t capacity) {
+    std::size_t result = 2;
+    while (result < capacity)
+        result <<= 1;
+
+    return result;
+}
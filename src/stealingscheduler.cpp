@@ -0,0 +1,109 @@
+#include "stealingscheduler.h"
+
+constexpr unsigned int unlimitedQueueSize = 4096;     //per worker, there is no such thing as an unbounded lock-free ring
+
+StealingScheduler::StealingScheduler(unsigned int workers, unsigned int limit):
+    queues(),
+    nextQueue(0),
+    terminate(false),
+    sleepingWorkers(0),
+    workerMutex(),
+    workerConditional(),
+    sleepingProducers(0),
+    producerMutex(),
+    producerConditional()
+{
+    if (workers == 0)
+        workers = 1;
+
+    unsigned int size = unlimitedQueueSize;
+    if (limit != 0)
+        size = (limit + workers - 1) / workers;
+
+    for (unsigned int i = 0; i < workers; ++i)
+        queues.emplace_back(std::make_unique<Ring<Job>>(size));
+}
+
+void StealingScheduler::push(Job&& job) {
+    while (!tryPush(job)) {
+        std::unique_lock lock(producerMutex);
+        sleepingProducers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (terminate.load() || tryPush(job)) {
+            sleepingProducers.fetch_sub(1);
+            break;
+        }
+
+        producerConditional.wait(lock);     //all queues are full, waiting for workers to take something
+        sleepingProducers.fetch_sub(1);
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepingWorkers.load() > 0) {
+        std::lock_guard lock(workerMutex);
+        workerConditional.notify_one();
+    }
+}
+
+std::optional<Job> StealingScheduler::pop(unsigned int worker) {
+    std::optional<Job> job;
+    while (true) {
+        job = tryPop(worker);
+        if (job.has_value() || terminate.load())
+            break;
+
+        std::unique_lock lock(workerMutex);
+        sleepingWorkers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        job = tryPop(worker);       //someone could have pushed between the last attempt and announcing the sleep
+        if (job.has_value() || terminate.load()) {
+            sleepingWorkers.fetch_sub(1);
+            break;
+        }
+
+        workerConditional.wait(lock);
+        sleepingWorkers.fetch_sub(1);
+    }
+
+    if (terminate.load())
+        return std::nullopt;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepingProducers.load() > 0) {
+        std::lock_guard lock(producerMutex);
+        producerConditional.notify_one();
+    }
+
+    return job;
+}
+
+void StealingScheduler::stop() {
+    terminate.store(true);
+    {
+        std::lock_guard lock(workerMutex);
+        workerConditional.notify_all();
+    }
+    std::lock_guard lock(producerMutex);
+    producerConditional.notify_all();
+}
+
+bool StealingScheduler::tryPush(Job& job) {
+    std::size_t first = nextQueue.fetch_add(1, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < queues.size(); ++i) {
+        Ring<Job>& queue = *queues[(first + i) % queues.size()];
+        if (queue.push(std::move(job)))
+            return true;
+    }
+
+    return false;
+}
+
+std::optional<Job> StealingScheduler::tryPop(unsigned int worker) {
+    for (std::size_t i = 0; i < queues.size(); ++i) {   //own queue first, then the neighbours
+        std::optional<Job> job = queues[(worker + i) % queues.size()]->pop();
+        if (job.has_value())
+            return job;
+    }
+
+    return std::nullopt;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "scheduler.h"
+#include "ring.h"
+
+//Every worker has its own lock-free queue, producers deal jobs to them in turns,
+//a worker that runs out of its own jobs steals from the others.
+//Mutexes here are only used to put idle threads to sleep, never on the way of a job
+class StealingScheduler : public Scheduler {
+public:
+    StealingScheduler(unsigned int workers, unsigned int limit);
+
+    void push(Job&& job) override;
+    std::optional<Job> pop(unsigned int worker) override;
+    void stop() override;
+
+private:
+    bool tryPush(Job& job);
+    std::optional<Job> tryPop(unsigned int worker);
+
+private:
+    std::vector<std::unique_ptr<Ring<Job>>> queues;
+    std::atomic<std::size_t> nextQueue;
+    std::atomic<bool> terminate;
+
+    std::atomic<unsigned int> sleepingWorkers;
+    std::mutex workerMutex;
+    std::condition_variable workerConditional;
+
+    std::atomic<unsigned int> sleepingProducers;
+    std::mutex producerMutex;
+    std::condition_variable producerConditional;
+};
@@ -1,136 +1,446 @@
 #include "taskmanager.h"
 
-#include "flactomp3.h"
+#include <algorithm>
+
+#include <metadata.h>
 
-TaskManager::TaskManager(const std::shared_ptr<Settings>& settings, const std::shared_ptr<Printer>& logger):
+#include "flactomp3.h"
+#include "inputreader.h"
+#include "queuescheduler.h"
+#include "stealingscheduler.h"
+#include "longestscheduler.h"
+
+constexpr uint64_t mebibyte = 1024 * 1024;
+constexpr uint64_t convertFootprint = 12 * mebibyte;  //LAME, libFLAC and the tag, without the pictures
+constexpr uint64_t keptFootprint = 4 * mebibyte;      //the IO, PCM and MP3 buffers an encoding thread keeps from one file to the next
+constexpr uint64_t keptRingFootprint = 5 * mebibyte;  //and with io_uring the block read ahead and the output blocks in flight
+constexpr uint64_t copyFootprint = mebibyte;
+constexpr uint64_t pictureCopies = 3;                 //libFLAC block, TagLib frame and the rendered ID3 tag
+constexpr unsigned int pipelineThreads = 2;           //the encoder and the writer, the decoder stays on the worker
+constexpr uint64_t encoderRate = 48000;               //LAME never gets more, hi-res sources are resampled before it
+
+TaskManager::TaskManager(const std::shared_ptr<Settings>& settings, const std::shared_ptr<Printer>& logger, const std::shared_ptr<Manifest>& manifest):
     settings(settings),
     logger(logger),
-    busyThreads(0),
+    manifest(manifest),
+    encoding(Manifest::encodingParameters(settings)),
     maxTasks(0),
     completeTasks(0),
-    terminate(false),
+    skippedTasks(0),
+    reusedTasks(0),
     running(false),
-    queueMutex(),
-    loopConditional(),
+    mutex(),
+    waitMutex(),
     waitConditional(),
-    threads(),
-    jobs()
+    encoders(),
+    copiers(),
+    budget(uint64_t(settings->getMemoryBudget()) * mebibyte),
+    copyEngine(settings->getCopyMode()),
+    readaheadMutex(),
+    readingAhead(),
+    report(),
+    memoryMutex(),
+    memory(),
+    residentSum(0),
+    residentCount(0)
 {
+    unsigned int workers = settings->getThreads();
+    if (workers == 0)
+        workers = std::thread::hardware_concurrency();
+
+    std::unique_ptr<Scheduler> scheduler;
+    switch (settings->getScheduling()) {
+        case Settings::stealing:
+            scheduler = std::make_unique<StealingScheduler>(workers, settings->getQueueLimit());
+            break;
+        case Settings::longest:
+            scheduler = std::make_unique<LongestScheduler>();
+            break;
+        default:
+            scheduler = std::make_unique<QueueScheduler>(settings->getQueueLimit());
+            break;
+    }
+    encoders = std::make_unique<Pool>("encoder", workers, std::move(scheduler));
+
+    unsigned int copyWorkers = settings->getCopyThreads();
+    if (copyWorkers != 0)       //copies mostly wait for the disk, the order doesn't matter for them
+        copiers = std::make_unique<Pool>("copier", copyWorkers, std::make_unique<QueueScheduler>(settings->getQueueLimit()));
+
+    std::string reportPath = settings->getReportPath();
+    if (!reportPath.empty() || settings->isPerfCounting())      //the counters are summed up in the report even if it's not written
+        report = std::make_unique<Report>(reportPath);
 }
 
 TaskManager::~TaskManager() {
 }
 
-void TaskManager::queueConvert(const std::filesystem::path& source, const std::filesystem::path& destination) {
-    if (settings->isExcluded(source))
-        return;
+TaskManager::Pool::Pool(const std::string& name, unsigned int workers, std::unique_ptr<Scheduler>&& scheduler):
+    name(name),
+    workers(workers),
+    scheduler(std::move(scheduler)),
+    threads(),
+    maxTasks(0),
+    completeTasks(0),
+    coreMutex(),
+    coreConditional(),
+    busyWorkers(0),
+    lentCores(0)
+{}
+
+void TaskManager::Pool::occupy() {
+    std::unique_lock lock(coreMutex);
+    while (busyWorkers + lentCores >= workers)
+        coreConditional.wait(lock);
+
+    ++busyWorkers;
+}
+
+void TaskManager::Pool::vacate() {
+    std::unique_lock lock(coreMutex);
+    --busyWorkers;
+    lock.unlock();
 
-    std::unique_lock<std::mutex> lock(queueMutex);
-    jobs.emplace(Job::convert, source, destination);
+    coreConditional.notify_one();
+}
 
-    ++maxTasks;
-    logger->setStatusMessage(std::to_string(completeTasks) + "/" + std::to_string(maxTasks));
+unsigned int TaskManager::Pool::lend(unsigned int wanted) {
+    std::lock_guard lock(coreMutex);
+    unsigned int count = std::min(wanted, workers - busyWorkers - lentCores);
+    lentCores += count;
+    return count;
+}
+
+void TaskManager::Pool::giveBack(unsigned int count) {
+    if (count == 0)
+        return;
 
+    std::unique_lock lock(coreMutex);
+    lentCores -= count;
     lock.unlock();
-    loopConditional.notify_one();
+
+    coreConditional.notify_all();
 }
 
-void TaskManager::queueCopy(const std::filesystem::path& source, const std::filesystem::path& destination) {
-    if (!settings->matchNonMusic(source.filename()))
+void TaskManager::queueConvert(const std::shared_ptr<const Directory>& directory, const std::string& name, const Manifest::Entry& described) {
+    if (settings->isExcluded(described.source))
         return;
 
-    std::unique_lock<std::mutex> lock(queueMutex);
-    jobs.emplace(Job::copy, source, destination);
-    ++maxTasks;
-    logger->setStatusMessage(std::to_string(completeTasks) + "/" + std::to_string(maxTasks));
+    std::string output = std::filesystem::path(name).stem().string();
+    switch (settings->getType()) {
+        case Settings::mp3:
+            output += ".mp3";
+            break;
+        default:
+            break;
+    }
 
-    lock.unlock();
-    loopConditional.notify_one();
+    std::filesystem::path destination = directory->destination() / output;
+    Manifest::Entry entry = described;
+    entry.parameters = encoding;
+    if (!isOutdated(destination, entry) || reuse(destination, entry))
+        return;
+
+    Job job(Job::convert, directory, name, output, entry);
+    if (settings->getScheduling() == Settings::longest || budget.getLimit() != 0 || settings->getSplitLongerThan() > 0)
+        estimate(job);      //runs on the scanning threads, it's just the headers of the metadata blocks, splitting needs the duration from them
+
+    enqueue(std::move(job));
+}
+
+void TaskManager::queueCopy(const std::shared_ptr<const Directory>& directory, const std::string& name, const Manifest::Entry& described) {
+    if (!settings->matchNonMusic(name))
+        return;
+
+    Manifest::Entry entry = described;
+    entry.parameters = Manifest::copyParameters();
+    if (!isOutdated(directory->destination() / name, entry))
+        return;
+
+    Job job(Job::copy, directory, name, name, entry);
+    job.footprint = copyFootprint;
+    enqueue(std::move(job));
+}
+
+void TaskManager::finishQueueing() {
+    encoders->scheduler->finishPushing();
+    if (copiers)
+        copiers->scheduler->finishPushing();
+}
+
+void TaskManager::enqueue(Job&& job) {
+    Pool& pool = poolFor(job);
+    job.queued = Timing::now().wall;
+    ++maxTasks;     //before the job is visible, so that wait never sees more complete tasks than there are
+    ++pool.maxTasks;
+    pool.scheduler->push(std::move(job));
+    logger->setStatusMessage(statusMessage());
+}
+
+void TaskManager::readAhead(Pool& pool, const Job& job) {
+    unsigned int count = settings->getReadahead();
+    if (count == 0)
+        return;
+
+    std::vector<std::filesystem::path> next = pool.scheduler->upcoming(count);
+    std::vector<std::filesystem::path> fresh;
+    {
+        std::lock_guard lock(readaheadMutex);
+        readingAhead.erase(job.source());
+        for (std::filesystem::path& source : next) {
+            if (readingAhead.insert(source).second)
+                fresh.push_back(std::move(source));
+        }
+    }
+
+    for (const std::filesystem::path& source : fresh)       //opening might take a while on a network drive, not under the lock
+        InputReader::prefetch(source.string());
+}
+
+TaskManager::Pool& TaskManager::poolFor(const Job& job) {
+    if (job.type == Job::copy && copiers)
+        return *copiers;
+
+    return *encoders;
+}
+
+bool TaskManager::isOutdated(const std::filesystem::path& destination, const Manifest::Entry& entry) {
+    if (entry.size == 0 && entry.mtime == 0)
+        return true;        //couldn't stat the source, let the job fail and report why
+
+    if (!settings->isIncremental() && !manifest->wasJournaled(destination))
+        return true;        //what an interrupted run has finished is skipped anyway
+
+    if (!manifest->isUpToDate(destination, entry))
+        return true;
+
+    ++skippedTasks;
+    return false;
+}
+
+bool TaskManager::reuse(const std::filesystem::path& destination, Manifest::Entry& entry) {
+    if (!settings->isIncremental() || entry.size == 0)
+        return false;
+
+    if (!manifest->mightHaveIdentical(destination) || !Manifest::identify(entry.source, entry))
+        return false;
+
+    std::optional<std::pair<std::filesystem::path, Manifest::Entry>> previous = manifest->findIdentical(destination, entry);
+    if (!previous.has_value())
+        return false;
+
+    const std::filesystem::path& output = previous->first;
+    std::error_code ec;
+    bool moved = !std::filesystem::exists(previous->second.source, ec);
+    if (moved) {
+        std::filesystem::rename(output, destination, ec);      //replaces the old destination in one step, it's never missing
+        if (ec)
+            return false;
+
+        manifest->erase(output);
+        logger->info("Source " + previous->second.source + " was moved, moving " + output.string() + " to " + destination.string());
+    } else {
+        std::error_code ignored;
+        std::filesystem::path temp = destination;       //the link takes the place of the old destination in one rename, the way the copies do
+        temp += ".part";
+        std::filesystem::remove(temp, ignored);
+        std::filesystem::create_hard_link(output, temp, ec);
+        if (ec) {
+            ec.clear();
+            std::filesystem::copy_file(output, temp, std::filesystem::copy_options::overwrite_existing, ec);
+        }
+        if (!ec)
+            std::filesystem::rename(temp, destination, ec);
+        if (ec) {
+            std::filesystem::remove(temp, ignored);
+            return false;
+        }
+        logger->info("Source " + entry.source + " has the same audio as " + previous->second.source + ", linking " + output.string() + " to " + destination.string());
+    }
+    manifest->update(destination, entry);
+
+    ++reusedTasks;
+    return true;
 }
 
 bool TaskManager::busy() const {
-    std::lock_guard lock(queueMutex);
-    return !jobs.empty();
+    return completeTasks != maxTasks;
 }
 
 void TaskManager::start() {
-    std::lock_guard lock(queueMutex);
+    std::lock_guard lock(mutex);
     if (running)
         return;
 
-    unsigned int amount = settings->getThreads();
-    if (amount == 0)
-        amount = std::thread::hardware_concurrency();
+    for (Pool* pool : {encoders.get(), copiers.get()}) {
+        if (pool == nullptr)
+            continue;
 
-    for (uint32_t i = 0; i < amount; ++i)
-        threads.emplace_back(std::thread(&TaskManager::loop, this));
+        for (uint32_t i = 0; i < pool->workers; ++i)
+            pool->threads.emplace_back(std::thread(&TaskManager::loop, this, std::ref(*pool), i));
+    }
 
     running = true;
 }
 
-void TaskManager::loop() {
+void TaskManager::loop(Pool& pool, unsigned int index) {
+    Trace::nameThread(pool.name + " " + std::to_string(index));
+    uint64_t keeps = settings->getIOBackend() == Settings::uring ? keptFootprint + keptRingFootprint : keptFootprint;
+    bool keeping = false;       //the buffers of this thread are charged to its first conversion and never given back
     while (true) {
-        std::unique_lock<std::mutex> lock(queueMutex);
-        while (!terminate && jobs.empty())
-            loopConditional.wait(lock);
-
-        if (terminate)
+        std::optional<Job> job;
+        {
+            Trace::Span span("wait", "idle");
+            job = pool.scheduler->pop(index);
+        }
+        if (!job.has_value())
             return;
 
-        Job job = jobs.front();
-        ++busyThreads;
-        jobs.pop();
-        lock.unlock();
-
-        JobResult result = execute(job);
-
-        lock.lock();
-        ++completeTasks;
-        printResult(job, result);
-        --busyThreads;
-        lock.unlock();
-        waitConditional.notify_all();
+        uint64_t kept = 0;
+        if (job->type == Job::convert) {
+            readAhead(pool, job.value());
+            if (!keeping) {
+                kept = keeps;
+                job->footprint += kept;
+                keeping = true;
+            }
+        }
+
+        pool.occupy();      //the memory is only taken once there is a core to use it, not held while waiting for one
+        {
+            Trace::Span span("wait", "memory budget");
+            budget.acquire(job->footprint);
+        }
+        Trace::Span span(job->type == Job::convert ? "convert" : "copy", job->name);
+        Timing timing;
+        Timing::Sample started = Timing::now();
+        timing.add(Timing::queue, {started.wall - job->queued, 0, {}});     //waiting for a core and the memory budget counts too
+        bool measured = budget.getLimit() > 0 || report;     //every reading parses /proc/self/status, only if someone looks at it
+        uint64_t peak = measured ? MemoryBudget::peakResidentSize() : 0;
+        JobResult result = execute(job.value(), timing);
+        uint64_t resident = measured ? MemoryBudget::residentSize() : 0;
+        pool.vacate();
+        if (report)
+            report->add(job.value(), result.first, timing.getSamples(), Timing::now().wall - started.wall, resident);
+
+        budget.keep(kept);
+        budget.release(job->footprint - kept);
+        record(job.value(), result.first);
+        if (measured)
+            recordMemory(job.value(), MemoryBudget::peakResidentSize() - peak, resident);
+
+        ++pool.completeTasks;
+        unsigned int complete = ++completeTasks;
+        printResult(job.value(), std::move(result));       //no scheduling lock is held here, the printer has its own
+        if (complete == maxTasks) {
+            std::lock_guard lock(waitMutex);
+            waitConditional.notify_all();
+        }
     }
 }
 
 void TaskManager::stop() {
-    std::unique_lock lock(queueMutex);
+    std::unique_lock lock(mutex);
     if (!running)
         return;
 
-    terminate = true;
+    for (Pool* pool : {encoders.get(), copiers.get()}) {
+        if (pool == nullptr)
+            continue;
 
-    lock.unlock();
-    loopConditional.notify_all();
-    for (std::thread& thread : threads)
-        thread.join();
+        pool->scheduler->stop();
+        for (std::thread& thread : pool->threads)
+            thread.join();
+
+        pool->threads.clear();
+    }
 
-    lock.lock();
-    threads.clear();
     running = false;
     logger->clearStatusMessage();
 }
 
 void TaskManager::wait() {
-    std::unique_lock lock(queueMutex);
-    while (busyThreads != 0 || !jobs.empty())
+    std::unique_lock lock(waitMutex);
+    while (completeTasks != maxTasks)
         waitConditional.wait(lock);
 }
 
 unsigned int TaskManager::getCompleteTasks() const {
-    std::lock_guard lock(queueMutex);
     return completeTasks;
 }
 
-TaskManager::JobResult TaskManager::execute(Job& job) {
+unsigned int TaskManager::getSkippedTasks() const {
+    return skippedTasks;
+}
+
+unsigned int TaskManager::getReusedTasks() const {
+    return reusedTasks;
+}
+
+bool TaskManager::writeReport(double seconds) const {
+    if (!report || report->getPath().empty())
+        return true;
+
+    return report->write(seconds);
+}
+
+std::string TaskManager::countersSummary() const {
+    if (!report || !PerfCounters::isEnabled())
+        return "";
+
+    return report->countersSummary();
+}
+
+TaskManager::MemoryStatistics TaskManager::getMemoryStatistics() const {
+    std::lock_guard lock(memoryMutex);
+    MemoryStatistics result = memory;
+    result.peak = MemoryBudget::peakResidentSize();
+    return result;
+}
+
+void TaskManager::recordMemory(const Job& job, uint64_t peakRise, uint64_t resident) {
+    std::lock_guard lock(memoryMutex);
+    residentSum += resident;
+    memory.averageResident = residentSum / ++residentCount;
+    memory.maxResident = std::max(memory.maxResident, resident);
+    if (peakRise > memory.largestPeakRise) {
+        memory.largestPeakRise = peakRise;
+        memory.largestPeakRiseSource = job.source().string();
+        memory.largestPeakRiseEstimate = job.footprint;
+    }
+}
+
+void TaskManager::record(const Job& job, bool success) {
+    std::filesystem::path destination = job.destination();
+    if (!success) {
+        manifest->erase(destination);
+        return;
+    }
+
+    Manifest::Entry entry;
+    entry.source = job.source().string();
+    entry.size = job.size;
+    entry.mtime = job.mtime;
+    entry.md5 = job.md5;
+    entry.tags = job.tags;      //the ones that went to the output, so that it's reused only for the same ones
     switch (job.type) {
         case Job::copy:
-            return copyJob(job, settings);
+            entry.parameters = Manifest::copyParameters();
+            break;
+        case Job::convert:
+            entry.parameters = encoding;
+            break;
+    }
+    manifest->update(destination, entry);
+}
+
+TaskManager::JobResult TaskManager::execute(Job& job, Timing& timing) {
+    switch (job.type) {
+        case Job::copy:
+            return copyJob(job, timing);
         case Job::convert:
             switch (settings->getType()) {
                 case Settings::mp3:
-                    job.destination.replace_extension("mp3");
-                    return mp3Job(job, settings);
+                    return mp3Job(job, settings, *encoders, timing);
                 default:
                     break;
             }
@@ -141,7 +451,7 @@ TaskManager::JobResult TaskManager::execute(Job& job) {
     }};
 }
 
-void TaskManager::printResult(const TaskManager::Job& job, const TaskManager::JobResult& result) {
+void TaskManager::printResult(const Job& job, TaskManager::JobResult&& result) {
     std::string msg;
     switch (job.type) {
         case Job::copy:
@@ -160,34 +470,102 @@ void TaskManager::printResult(const TaskManager::Job& job, const TaskManager::Jo
 
     logger->printNested(
         msg,
-        {"Source: \t" + job.source.string(), "Destination: \t" + job.destination.string()},
-        result.second,
-        std::to_string(completeTasks) + "/" + std::to_string(maxTasks)
+        {"Source: \t" + job.source().string(), "Destination: \t" + job.destination().string()},
+        std::move(result.second),
+        statusMessage()
     );
 }
 
-TaskManager::JobResult TaskManager::mp3Job(const TaskManager::Job& job, const std::shared_ptr<Settings>& settings) {
-    FLACtoMP3 convertor(settings->getLogLevel());
-    convertor.setInputFile(job.source);
-    convertor.setOutputFile(job.destination);
+std::string TaskManager::statusMessage() const {
+    std::string result = std::to_string(encoders->completeTasks) + "/" + std::to_string(encoders->maxTasks);
+    if (copiers)
+        result += ", copied " + std::to_string(copiers->completeTasks) + "/" + std::to_string(copiers->maxTasks);
+
+    return result;
+}
+
+TaskManager::JobResult TaskManager::mp3Job(Job& job, const std::shared_ptr<Settings>& settings, Pool& pool, Timing& timing) {
+    thread_local std::unique_ptr<FLACtoMP3> context;     //every worker keeps its decoder and buffers from one file to the next
+    if (!context)
+        context = std::make_unique<FLACtoMP3>(settings->getLogLevel());
+
+    FLACtoMP3& convertor = *context;
+    convertor.setInputFile(job.source());
+    convertor.setOutputFile(job.destination());
     convertor.setParameters(settings->getEncodingQuality(), settings->getOutputQuality(), settings->getVBR());
-    bool result = convertor.run();
+    uint32_t splitLongerThan = settings->getSplitLongerThan();
+    unsigned int helpers = 0;       //the threads the conversion starts next to this one, on the cores of the idle workers
+    if (splitLongerThan > 0 && job.duration >= splitLongerThan) {
+        helpers = pool.lend(pool.workers - 1);
+    } else if (settings->isPipelined()) {
+        helpers = pool.lend(pipelineThreads);
+        if (helpers < pipelineThreads) {        //it takes both stages or none
+            pool.giveBack(helpers);
+            helpers = 0;
+        }
+    }
 
-    return {result, convertor.getHistory()};
+    convertor.setSegmentation(splitLongerThan, helpers + 1);
+    convertor.setPipelined(settings->isPipelined() && helpers >= pipelineThreads);
+    convertor.setResampling(settings->getSampleRate(), settings->getResampling() == Settings::polyphase);
+    bool result = convertor.run();
+    pool.giveBack(helpers);
+    job.md5 = convertor.getStreamMD5();
+    job.tags = convertor.getTagDigest();
+    job.duration = convertor.getDuration();
+    timing.add(convertor.getTimings());
+    JobResult jobResult = {result, convertor.takeHistory()};
+    convertor.reset();      //the source is closed and the decoder let go now, not when the next file comes, if it ever does
+
+    return jobResult;
 }
 
-TaskManager::JobResult TaskManager::copyJob(const TaskManager::Job& job, const std::shared_ptr<Settings>& settings) {
-    (void)(settings);
-    bool success = std::filesystem::copy_file(
-        job.source,
-        job.destination,
-        std::filesystem::copy_options::overwrite_existing
-    );
+TaskManager::JobResult TaskManager::copyJob(const Job& job, Timing& timing) {
+    Timing::Scope scope(timing, Timing::write);
+    CopyEngine::Result result = copyEngine.copy(job.source(), job.destination());
+    if (!result.success)
+        return {false, {{Logger::Severity::error, result.error}}};
 
-    return {success, {}};
+    Logger::History messages;
+    if (!result.error.empty())
+        messages.emplace_back(Logger::Severity::minor, result.error + ", used " + std::string(CopyEngine::methodName(result.method)) + " instead");
+
+    return {true, messages};
 }
 
-TaskManager::Job::Job(Type type, const std::filesystem::path& source, std::filesystem::path destination):
-    type(type),
-    source(source),
-    destination(destination) {}
+void TaskManager::estimate(Job& job) {
+    job.cost = job.size / 4;    //in case the length is unknown, FLAC usually takes a bit more than two bytes per stereo sample, 44.1 of them in a millisecond
+    job.footprint = convertFootprint;
+
+    FLAC__Metadata_SimpleIterator* iterator = FLAC__metadata_simple_iterator_new();
+    if (iterator == nullptr)
+        return;
+
+    if (FLAC__metadata_simple_iterator_init(iterator, job.source().c_str(), true, false)) {
+        do {
+            switch (FLAC__metadata_simple_iterator_get_block_type(iterator)) {
+                case FLAC__METADATA_TYPE_STREAMINFO: {
+                    FLAC__StreamMetadata* info = FLAC__metadata_simple_iterator_get_block(iterator);
+                    if (info != nullptr) {
+                        const FLAC__StreamMetadata_StreamInfo& stream = info->data.stream_info;
+                        if (stream.total_samples > 0 && stream.sample_rate > 0) {
+                            uint64_t milliseconds = stream.total_samples * 1000 / stream.sample_rate;
+                            uint64_t channels = std::min(stream.channels, 2u);     //more are mixed down before LAME
+                            job.cost = milliseconds * channels * (encoderRate + stream.sample_rate) / encoderRate;  //encoding, then decoding and resampling that grow with the rate
+                            job.duration = double(stream.total_samples) / stream.sample_rate;
+                        }
+
+                        FLAC__metadata_object_delete(info);
+                    }
+                }   break;
+                case FLAC__METADATA_TYPE_PICTURE:       //only the length from the block header, the picture itself is not read
+                    job.footprint += pictureCopies * FLAC__metadata_simple_iterator_get_block_length(iterator);
+                    break;
+                default:
+                    break;
+            }
+        } while (FLAC__metadata_simple_iterator_next(iterator));
+    }
+
+    FLAC__metadata_simple_iterator_delete(iterator);
+}
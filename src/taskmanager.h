@@ -7,7 +7,7 @@
 #include <filesystem>
 #include <vector>
 #include <list>
-#include <queue>
+#include <set>
 #include <string>
 #include <atomic>
 #include <iostream>
@@ -15,54 +15,110 @@
 #include <memory>
 
 #include "settings.h"
+#include "manifest.h"
+#include "directory.h"
+#include "job.h"
+#include "scheduler.h"
+#include "memorybudget.h"
+#include "copyengine.h"
+#include "timing.h"
+#include "report.h"
+#include "trace.h"
 #include "logger/printer.h"
 
 class TaskManager {
-    using JobResult = std::pair<bool, std::list<Logger::Message>>;
-    struct Job;
+    using JobResult = std::pair<bool, Logger::History>;
 public:
-    TaskManager(const std::shared_ptr<Settings>& settings, const std::shared_ptr<Printer>& logger);
+    struct MemoryStatistics {
+        uint64_t peak;                  //resident size of the whole process
+        uint64_t largestPeakRise;       //the most the peak of the process rose while a job ran, the jobs of the other threads add to it too
+        std::string largestPeakRiseSource;
+        uint64_t largestPeakRiseEstimate;
+        uint64_t averageResident;       //resident size at the end of a job
+        uint64_t maxResident;
+    };
+
+    TaskManager(const std::shared_ptr<Settings>& settings, const std::shared_ptr<Printer>& logger, const std::shared_ptr<Manifest>& manifest);
     ~TaskManager();
 
     void start();
-    void queueConvert(const std::filesystem::path& source, const std::filesystem::path& destination);
-    void queueCopy(const std::filesystem::path& source, const std::filesystem::path& destination);
+    void queueConvert(const std::shared_ptr<const Directory>& directory, const std::string& name, const Manifest::Entry& described);
+    void queueCopy(const std::shared_ptr<const Directory>& directory, const std::string& name, const Manifest::Entry& described);
+    void finishQueueing();
     void stop();
     bool busy() const;
     void wait();
 
     unsigned int getCompleteTasks() const;
+    unsigned int getSkippedTasks() const;
+    unsigned int getReusedTasks() const;
+    MemoryStatistics getMemoryStatistics() const;
+    bool writeReport(double seconds) const;
+    std::string countersSummary() const;
 
 private:
-    void loop();
-    JobResult execute(Job& job);
-    void printResult(const Job& job, const JobResult& result);
-    static JobResult mp3Job(const Job& job, const std::shared_ptr<Settings>& settings);
-    static JobResult copyJob(const Job& job, const std::shared_ptr<Settings>& settings);
+    struct Pool;
+
+    void loop(Pool& pool, unsigned int index);
+    Pool& poolFor(const Job& job);
+    bool isOutdated(const std::filesystem::path& destination, const Manifest::Entry& entry);
+    bool reuse(const std::filesystem::path& destination, Manifest::Entry& entry);
+    void enqueue(Job&& job);
+    void readAhead(Pool& pool, const Job& job);
+    void record(const Job& job, bool success);
+    void recordMemory(const Job& job, uint64_t peakRise, uint64_t resident);
+    JobResult execute(Job& job, Timing& timing);
+    void printResult(const Job& job, JobResult&& result);
+    std::string statusMessage() const;
+    static JobResult mp3Job(Job& job, const std::shared_ptr<Settings>& settings, Pool& pool, Timing& timing);
+    JobResult copyJob(const Job& job, Timing& timing);
+    static void estimate(Job& job);
 
 private:
     std::shared_ptr<Settings> settings;
     std::shared_ptr<Printer> logger;
-    unsigned int busyThreads;
-    unsigned int maxTasks;
-    unsigned int completeTasks;
-    bool terminate;
+    std::shared_ptr<Manifest> manifest;
+    std::string encoding;
+    std::atomic<unsigned int> maxTasks;
+    std::atomic<unsigned int> completeTasks;
+    std::atomic<unsigned int> skippedTasks;
+    std::atomic<unsigned int> reusedTasks;
     bool running;
-    mutable std::mutex queueMutex;
-    std::condition_variable loopConditional;
+    std::mutex mutex;
+    std::mutex waitMutex;
     std::condition_variable waitConditional;
-    std::vector<std::thread> threads;
-    std::queue<Job> jobs;
-
+    std::unique_ptr<Pool> encoders;
+    std::unique_ptr<Pool> copiers;      //copies take the encoding threads if there is no separate pool
+    MemoryBudget budget;
+    CopyEngine copyEngine;
+    std::mutex readaheadMutex;
+    std::set<std::filesystem::path> readingAhead;      //sources already asked to be read ahead that haven't started yet
+    std::unique_ptr<Report> report;     //only if it or the hardware counters were asked for
+    mutable std::mutex memoryMutex;
+    MemoryStatistics memory;
+    uint64_t residentSum;
+    uint64_t residentCount;
 };
 
-struct TaskManager::Job {
-    enum Type {
-        copy,
-        convert
-    };
-    Job(Type type, const std::filesystem::path& source, std::filesystem::path destination);
-    Type type;
-    std::filesystem::path source;
-    std::filesystem::path destination;
+//Threads that take one class of jobs from their own scheduler and count their own progress.
+//A job can borrow the cores of the idle workers for the threads it starts on its own,
+//a worker that gets a job while they are borrowed waits for them to come back, so there are never more threads running than workers
+struct TaskManager::Pool {
+    Pool(const std::string& name, unsigned int workers, std::unique_ptr<Scheduler>&& scheduler);
+
+    void occupy();
+    void vacate();
+    unsigned int lend(unsigned int wanted);
+    void giveBack(unsigned int count);
+
+    const std::string name;
+    const unsigned int workers;
+    std::unique_ptr<Scheduler> scheduler;
+    std::vector<std::thread> threads;
+    std::atomic<unsigned int> maxTasks;
+    std::atomic<unsigned int> completeTasks;
+    std::mutex coreMutex;
+    std::condition_variable coreConditional;
+    unsigned int busyWorkers;
+    unsigned int lentCores;
 };
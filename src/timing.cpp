@@ -0,0 +1,108 @@
+#include "timing.h"
+
+#include <time.h>
+
+#include "trace.h"
+
+constexpr std::array<std::string_view, Timing::_stagesSize> stageNames({
+    "queue",
+    "metadata",
+    "picture",
+    "decode",
+    "pcm",
+    "resample",
+    "encode",
+    "write"
+});
+
+static thread_local Timing::Scope* current = nullptr;
+
+static uint64_t nanoseconds(clockid_t clock) {
+    struct timespec time;
+    if (clock_gettime(clock, &time) != 0)
+        return 0;
+
+    return uint64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+Timing::Timing():
+    wall(),
+    cpu(),
+    counters()
+{
+    clear();
+}
+
+void Timing::add(Stage stage, const Sample& sample) {
+    wall[stage].fetch_add(sample.wall, std::memory_order_relaxed);
+    cpu[stage].fetch_add(sample.cpu, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < PerfCounters::_countersSize; ++i)
+        counters[stage][i].fetch_add(sample.counters[i], std::memory_order_relaxed);
+}
+
+void Timing::add(const Samples& samples) {
+    for (std::size_t i = 0; i < _stagesSize; ++i)
+        add(static_cast<Stage>(i), samples[i]);
+}
+
+void Timing::clear() {
+    for (std::size_t i = 0; i < _stagesSize; ++i) {
+        wall[i] = 0;
+        cpu[i] = 0;
+        for (std::atomic<uint64_t>& counter : counters[i])
+            counter = 0;
+    }
+}
+
+Timing::Samples Timing::getSamples() const {
+    Samples result;
+    for (std::size_t i = 0; i < _stagesSize; ++i) {
+        result[i].wall = wall[i].load(std::memory_order_relaxed);
+        result[i].cpu = cpu[i].load(std::memory_order_relaxed);
+        for (std::size_t j = 0; j < PerfCounters::_countersSize; ++j)
+            result[i].counters[j] = counters[i][j].load(std::memory_order_relaxed);
+    }
+
+    return result;
+}
+
+Timing::Sample Timing::now() {
+    return {nanoseconds(CLOCK_MONOTONIC), nanoseconds(CLOCK_THREAD_CPUTIME_ID), PerfCounters::read()};
+}
+
+uint64_t Timing::wallNow() {
+    return nanoseconds(CLOCK_MONOTONIC);
+}
+
+std::string_view Timing::stageName(Stage stage) {
+    return stageNames[stage];
+}
+
+Timing::Scope::Scope(Timing& timing, Stage stage):
+    timing(timing),
+    stage(stage),
+    start(now()),
+    nested({0, 0, {}}),
+    outer(current)
+{
+    current = this;
+}
+
+Timing::Scope::~Scope() {
+    Sample end = now();
+    Sample elapsed = {end.wall - start.wall, end.cpu - start.cpu, {}};
+    Sample own = {elapsed.wall - nested.wall, elapsed.cpu - nested.cpu, {}};
+    for (std::size_t i = 0; i < PerfCounters::_countersSize; ++i) {
+        elapsed.counters[i] = end.counters[i] - start.counters[i];
+        own.counters[i] = elapsed.counters[i] - nested.counters[i];
+    }
+    timing.add(stage, own);
+    Trace::record("stage", stageName(stage), start.wall, end.wall);
+    if (outer != nullptr) {
+        outer->nested.wall += elapsed.wall;
+        outer->nested.cpu += elapsed.cpu;
+        for (std::size_t i = 0; i < PerfCounters::_countersSize; ++i)
+            outer->nested.counters[i] += elapsed.counters[i];
+    }
+    current = outer;
+}
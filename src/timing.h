@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string_view>
+#include <cstdint>
+
+#include "perfcounters.h"
+
+//Wall and CPU time a job spends in each of its stages.
+//A scope opened inside another one on the same thread is taken out of the outer one,
+//so decoding doesn't count the encoding and writing that happen in its callbacks.
+//Stages of a pipelined or segmented conversion run on several threads, their times add up.
+//Hardware counters are only read if PerfCounters are enabled, otherwise they stay zeros
+class Timing {
+public:
+    enum Stage {
+        queue,
+        metadata,
+        picture,
+        decode,
+        pcm,
+        resample,
+        encode,
+        write,
+        _stagesSize
+    };
+
+    struct Sample {
+        uint64_t wall;      //nanoseconds
+        uint64_t cpu;       //nanoseconds of the calling thread
+        PerfCounters::Values counters;
+    };
+    using Samples = std::array<Sample, _stagesSize>;
+
+    class Scope {
+    public:
+        Scope(Timing& timing, Stage stage);
+        ~Scope();
+
+    private:
+        Timing& timing;
+        Stage stage;
+        Sample start;
+        Sample nested;
+        Scope* outer;
+    };
+
+    Timing();
+
+    void add(Stage stage, const Sample& sample);
+    void add(const Samples& samples);
+    void clear();
+    Samples getSamples() const;
+
+    static Sample now();
+    static uint64_t wallNow();
+    static std::string_view stageName(Stage stage);
+
+private:
+    std::array<std::atomic<uint64_t>, _stagesSize> wall;
+    std::array<std::atomic<uint64_t>, _stagesSize> cpu;
+    std::array<std::array<std::atomic<uint64_t>, PerfCounters::_countersSize>, _stagesSize> counters;
+};
@@ -0,0 +1,111 @@
+#include "trace.h"
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <iomanip>
+
+#include "timing.h"
+#include "report.h"
+
+namespace {
+    struct Event {
+        std::string_view category;      //only literals, they outlive the buffers
+        std::string name;
+        uint64_t start;
+        uint64_t duration;
+    };
+
+    struct Buffer {
+        unsigned int id;
+        std::string name;
+        std::deque<Event> events;       //grows without moving what is already recorded
+    };
+
+    std::mutex registryMutex;
+    std::vector<std::shared_ptr<Buffer>> buffers;       //they stay after their threads exit
+    thread_local std::shared_ptr<Buffer> local;
+
+    Buffer& threadBuffer() {
+        if (!local) {
+            local = std::make_shared<Buffer>();
+            std::lock_guard lock(registryMutex);
+            local->id = buffers.size() + 1;
+            local->name = "thread " + std::to_string(local->id);
+            buffers.push_back(local);
+        }
+
+        return *local;
+    }
+}
+
+std::atomic<bool> Trace::enabled(false);
+uint64_t Trace::origin(0);
+
+void Trace::enable() {
+    origin = Timing::wallNow();
+    enabled.store(true, std::memory_order_release);
+}
+
+bool Trace::isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void Trace::nameThread(const std::string& name) {
+    if (isEnabled())
+        threadBuffer().name = name;
+}
+
+void Trace::record(std::string_view category, std::string_view name, uint64_t start, uint64_t end) {
+    if (isEnabled())
+        threadBuffer().events.push_back({category, std::string(name), start, end - start});
+}
+
+bool Trace::write(const std::string& path) {
+    std::ofstream stream(path, std::ios::out | std::ios::trunc);
+    if (!stream.is_open())
+        return false;
+
+    std::lock_guard lock(registryMutex);
+    stream << std::fixed << std::setprecision(3);
+    stream << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const std::shared_ptr<Buffer>& buffer : buffers) {
+        stream << (first ? "" : ",\n")
+               << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->id
+               << ", \"args\": {\"name\": " << Report::quote(buffer->name) << "}}";
+        first = false;
+
+        for (const Event& event : buffer->events) {
+            uint64_t start = event.start > origin ? event.start - origin : 0;
+            stream << ",\n{\"name\": " << Report::quote(event.name)
+                   << ", \"cat\": " << Report::quote(std::string(event.category))
+                   << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->id
+                   << ", \"ts\": " << start / 1000.0
+                   << ", \"dur\": " << event.duration / 1000.0 << "}";
+        }
+    }
+    stream << "\n]}\n";
+
+    stream.close();
+    return !stream.fail();
+}
+
+Trace::Span::Span(std::string_view category, std::string_view name):
+    category(category),
+    name(),
+    start(0)
+{
+    if (!isEnabled())
+        return;
+
+    Span::name = name;
+    start = Timing::wallNow();
+}
+
+Trace::Span::~Span() {
+    if (start != 0)
+        record(category, name, start, Timing::wallNow());
+}
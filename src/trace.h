@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <cstdint>
+
+//Spans of work in the Chrome trace event format, chrome://tracing and ui.perfetto.dev open it.
+//Every thread records to its own buffer, so spans don't contend with each other.
+//When tracing is not enabled a span costs one relaxed load.
+//The buffers are read only by write, call it when the threads that record are done
+class Trace {
+public:
+    class Span {
+    public:
+        Span(std::string_view category, std::string_view name);
+        ~Span();
+
+    private:
+        std::string_view category;
+        std::string name;
+        uint64_t start;
+    };
+
+    static void enable();
+    static bool isEnabled();
+    static void nameThread(const std::string& name);
+    static void record(std::string_view category, std::string_view name, uint64_t start, uint64_t end);
+    static bool write(const std::string& path);
+
+private:
+    static std::atomic<bool> enabled;
+    static uint64_t origin;
+};
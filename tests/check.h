@@ -0,0 +1,26 @@
+#pragma once
+
+#include <iostream>
+
+//The unit tests don't need a framework: every failed check is printed with its line
+//and the test exits with 1 from finish(), so that ctest counts it as failed
+namespace Test {
+    inline unsigned int failures = 0;
+
+    inline void check(bool passed, const char* expression, const char* file, int line) {
+        if (passed)
+            return;
+
+        ++failures;
+        std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+    }
+
+    inline int finish() {
+        if (failures > 0)
+            std::cerr << failures << " checks failed" << std::endl;
+
+        return failures == 0 ? 0 : 1;
+    }
+}
+
+#define CHECK(expression) Test::check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
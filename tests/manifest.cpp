@@ -0,0 +1,119 @@
+#include "manifest.h"
+
+#include <fstream>
+
+#include <unistd.h>
+
+#include "check.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    Manifest::Entry makeEntry(const std::string& source, uint8_t md5, uint64_t tags) {
+        Manifest::Entry entry;
+        entry.source = source;
+        entry.size = 1234567;
+        entry.mtime = 1700000000123456789;
+        entry.md5.fill(md5);
+        entry.tags = tags;
+        entry.parameters = "mp3 quality 0 output 5 vbr float";
+        return entry;
+    }
+
+    void touch(const fs::path& path) {
+        fs::create_directories(path.parent_path());
+        std::ofstream(path) << "mp3";
+    }
+}
+
+int main() {
+    fs::path root = fs::temp_directory_path() / ("mlc-manifest-test-" + std::to_string(::getpid()));
+    fs::remove_all(root);
+    fs::create_directories(root);
+
+    fs::path first = root / "Artist" / "first.mp3";
+    fs::path second = root / "Artist" / "second song.mp3";
+    fs::path gone = root / "gone.mp3";
+    touch(first);
+    touch(second);
+    touch(gone);
+
+    Manifest::Entry firstEntry = makeEntry("/music/Artist/first.flac", 0xab, 77);
+    Manifest::Entry secondEntry = makeEntry("/music/Artist/second song.flac", 0xcd, 78);
+    {
+        Manifest manifest(root);
+        CHECK(!manifest.read());        //there is no manifest yet
+        manifest.update(first, firstEntry);
+        manifest.update(second, secondEntry);
+        manifest.update(gone, makeEntry("/music/gone.flac", 0xef, 79));
+        manifest.erase(gone);
+        CHECK(manifest.write());
+    }
+
+    {   //everything that was written is read back the same
+        Manifest manifest(root);
+        CHECK(manifest.read());
+        CHECK(!manifest.isResumed());       //the journal was folded into the manifest
+        CHECK(manifest.isUpToDate(first, firstEntry));
+        CHECK(manifest.isUpToDate(second, secondEntry));
+        CHECK(!manifest.isUpToDate(gone, makeEntry("/music/gone.flac", 0xef, 79)));
+
+        Manifest::Entry changed = firstEntry;
+        changed.mtime += 1;
+        CHECK(!manifest.isUpToDate(first, changed));
+        changed = firstEntry;
+        changed.parameters += " rate 44100";
+        CHECK(!manifest.isUpToDate(first, changed));
+
+        Manifest::Entry moved = firstEntry;       //the same audio and tags under another name
+        moved.source = "/music/Other/first.flac";
+        fs::path destination = root / "Other" / "first.mp3";
+        CHECK(manifest.mightHaveIdentical(destination));
+        std::optional<std::pair<fs::path, Manifest::Entry>> identical = manifest.findIdentical(destination, moved);
+        CHECK(identical.has_value());
+        if (identical.has_value()) {
+            CHECK(identical->first == first);
+            CHECK(identical->second.source == firstEntry.source);
+            CHECK(identical->second.md5 == firstEntry.md5);
+            CHECK(identical->second.tags == firstEntry.tags);
+        }
+
+        moved.tags = 80;        //other tags, the output would differ
+        CHECK(!manifest.findIdentical(destination, moved).has_value());
+    }
+
+    {   //an interrupted run has only the journal, it is replayed on top of the manifest
+        Manifest manifest(root);
+        manifest.read();
+        manifest.erase(second);
+        manifest.update(gone, makeEntry("/music/gone.flac", 0xef, 79));
+    }
+    {
+        Manifest manifest(root);
+        manifest.read();
+        CHECK(manifest.isResumed());
+        CHECK(manifest.wasJournaled(gone));
+        CHECK(manifest.isUpToDate(gone, makeEntry("/music/gone.flac", 0xef, 79)));
+        CHECK(!manifest.isUpToDate(second, secondEntry));
+        CHECK(manifest.isUpToDate(first, firstEntry));
+    }
+
+    {   //the lines of the versions without the tag digest are still up to date, but never reused
+        std::ofstream stream(root / ".mlc.manifest", std::ios::out | std::ios::trunc);
+        stream << "# mlc manifest 1\n"
+               << "Artist/first.mp3\t/music/Artist/first.flac\t1234567\t1700000000123456789\t"
+               << std::string(32, 'a') << "\tmp3 quality 0 output 5 vbr float\n";
+    }
+    fs::remove(root / ".mlc.journal");
+    {
+        Manifest manifest(root);
+        CHECK(manifest.read());
+        Manifest::Entry old = firstEntry;
+        old.md5.fill(0xaa);
+        CHECK(manifest.isUpToDate(first, old));
+        CHECK(!manifest.mightHaveIdentical(root / "Other" / "first.mp3"));
+    }
+
+    fs::remove_all(root);
+    return Test::finish();
+}
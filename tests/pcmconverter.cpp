@@ -0,0 +1,75 @@
+#include "pcmconverter.h"
+
+#include <vector>
+#include <cmath>
+
+#include "check.h"
+
+namespace {
+    constexpr std::size_t frames = 1003;        //not a multiple of the vector width, the tails are converted too
+    constexpr std::size_t offset = 5;
+
+    //every channel at the same sample, the loudest a mix can get
+    void convertConstant(PCMConverter& converter, int32_t sample, std::vector<float>& left, std::vector<float>& right) {
+        std::vector<std::vector<int32_t>> planes(converter.getChannels(), std::vector<int32_t>(offset + frames, sample));
+        std::vector<const int32_t*> input;
+        for (const std::vector<int32_t>& plane : planes)
+            input.push_back(plane.data());
+
+        left.assign(frames, 0);
+        right.assign(frames, 0);
+        converter.convert(input.data(), offset, left.data(), right.data(), frames);
+    }
+
+    float peak(const std::vector<float>& samples) {
+        float result = 0;
+        for (float sample : samples)
+            result = std::max(result, std::fabs(sample));
+
+        return result;
+    }
+
+    void fullScale() {      //mono and stereo are only scaled, the extremes land on ±1 exactly
+        std::vector<float> left;
+        std::vector<float> right;
+        for (uint32_t bits : {16u, 24u}) {
+            int32_t minimum = -(int32_t(1) << (bits - 1));
+            for (uint32_t channels : {1u, 2u}) {
+                PCMConverter converter;
+                converter.setFormat(channels, bits);
+                CHECK(converter.getOutputChannels() == channels);
+                convertConstant(converter, minimum, left, right);
+                CHECK(left.front() == -1.0f && left.back() == -1.0f);
+                if (channels == 2)
+                    CHECK(right.front() == -1.0f && right.back() == -1.0f);
+            }
+        }
+    }
+
+    void downmixDoesntClip() {
+        std::vector<float> left;
+        std::vector<float> right;
+        for (uint32_t bits : {16u, 24u}) {
+            int32_t maximum = (int32_t(1) << (bits - 1)) - 1;
+            int32_t minimum = -(int32_t(1) << (bits - 1));
+            for (uint32_t channels = 3; channels <= PCMConverter::maxChannels; ++channels) {
+                PCMConverter converter;
+                converter.setFormat(channels, bits);
+                CHECK(converter.getOutputChannels() == 2);
+                for (int32_t sample : {maximum, minimum}) {
+                    convertConstant(converter, sample, left, right);
+                    CHECK(peak(left) <= 1.0f);
+                    CHECK(peak(right) <= 1.0f);
+                    CHECK(peak(left) > 0.99f);      //scaled to the full range, not further down than it has to be
+                    CHECK(left.front() == right.front());   //the matrices are symmetric
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    fullScale();
+    downmixDoesntClip();
+    return Test::finish();
+}
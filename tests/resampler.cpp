@@ -0,0 +1,77 @@
+#include "resampler.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "check.h"
+
+namespace {
+    struct Rates {
+        uint32_t input;
+        uint32_t output;
+    };
+    constexpr float level = 0.5f;
+    constexpr std::size_t edge = 200;       //the filter reaches this far into the silence before and after the input
+
+    //feeds frames of a constant level in uneven blocks, returns the left channel of all the output
+    std::vector<float> resample(const Rates& rates, std::size_t frames) {
+        Resampler resampler;
+        CHECK(resampler.setRates(rates.input, rates.output, 2));
+        CHECK(resampler.isActive());
+
+        std::vector<float> result;
+        std::vector<float> left(4096);
+        std::vector<float> right(4096);
+        std::size_t done = 0;
+        bool drained = false;
+        while (!drained) {
+            if (done < frames) {
+                std::size_t count = std::min<std::size_t>(3001, frames - done);
+                std::array<float*, Resampler::maxChannels> input = resampler.prepare(count);
+                std::fill(input[0], input[0] + count, level);
+                std::fill(input[1], input[1] + count, -level);
+                resampler.push(count);
+                done += count;
+            } else {
+                resampler.drain();
+                drained = true;
+            }
+
+            std::size_t pulled;
+            while ((pulled = resampler.pull(left.data(), right.data(), left.size())) > 0) {
+                for (std::size_t i = 0; i < pulled; ++i)
+                    CHECK(right[i] == -left[i]);
+
+                result.insert(result.end(), left.begin(), left.begin() + pulled);
+            }
+        }
+
+        return result;
+    }
+
+    void nothingToDo() {
+        Resampler resampler;
+        CHECK(!resampler.setRates(44100, 44100, 2));
+        CHECK(!resampler.isActive());
+    }
+
+    void lengthAndGain() {
+        for (Rates rates : {Rates{96000, 48000}, Rates{96000, 44100}, Rates{88200, 44100}, Rates{192000, 48000}, Rates{44100, 48000}}) {
+            for (std::size_t frames : {std::size_t(1), std::size_t(1000), std::size_t(96001)}) {
+                std::vector<float> output = resample(rates, frames);
+                uint64_t expected = (uint64_t(frames) * rates.output + rates.input - 1) / rates.input;     //ends where the input ends
+                CHECK(output.size() == expected);
+
+                for (std::size_t i = edge; i + edge < output.size(); ++i)     //a constant stays the same, the gain of every phase is 1
+                    CHECK(std::fabs(output[i] - level) < 1e-4f);
+            }
+        }
+    }
+}
+
+int main() {
+    nothingToDo();
+    lengthAndGain();
+    return Test::finish();
+}
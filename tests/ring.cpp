@@ -0,0 +1,84 @@
+#include "ring.h"
+
+#include <thread>
+#include <vector>
+#include <memory>
+
+#include "check.h"
+
+namespace {
+    void singleThread() {
+        Ring<int> ring(5);
+        CHECK(ring.capacity() == 8);        //rounded up to a power of two
+        CHECK(!ring.pop().has_value());
+
+        for (int i = 0; i < 8; ++i)
+            CHECK(ring.push(int(i)));
+
+        CHECK(!ring.push(8));
+        for (int i = 0; i < 8; ++i) {
+            std::optional<int> value = ring.pop();
+            CHECK(value.has_value() && value.value() == i);
+        }
+        CHECK(!ring.pop().has_value());
+
+        for (int lap = 0; lap < 100; ++lap) {      //the positions go around the cells many times
+            CHECK(ring.push(int(lap)));
+            CHECK(ring.pop() == lap);
+        }
+    }
+
+    void fullKeepsTheValue() {
+        Ring<std::unique_ptr<int>> ring(2);
+        CHECK(ring.push(std::make_unique<int>(1)));
+        CHECK(ring.push(std::make_unique<int>(2)));
+        std::unique_ptr<int> third = std::make_unique<int>(3);
+        CHECK(!ring.push(std::move(third)));
+        CHECK(third && *third == 3);        //the printer retries with the same record
+    }
+
+    void manyThreads() {
+        constexpr unsigned int producers = 4;
+        constexpr unsigned int consumers = 4;
+        constexpr uint64_t perProducer = 100000;
+        constexpr uint64_t total = producers * perProducer;
+        Ring<uint64_t> ring(64);
+        std::atomic<uint64_t> sum(0);
+        std::atomic<uint64_t> count(0);
+
+        std::vector<std::thread> threads;
+        for (unsigned int p = 0; p < producers; ++p) {
+            threads.emplace_back([&ring, p] () {
+                for (uint64_t i = 0; i < perProducer; ++i) {
+                    while (!ring.push(p * perProducer + i))
+                        std::this_thread::yield();
+                }
+            });
+        }
+        for (unsigned int c = 0; c < consumers; ++c) {
+            threads.emplace_back([&ring, &sum, &count] () {
+                while (count < total) {
+                    std::optional<uint64_t> value = ring.pop();
+                    if (value.has_value()) {
+                        sum += value.value();
+                        ++count;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        CHECK(count == total);              //nothing is lost or taken twice
+        CHECK(sum == total * (total - 1) / 2);
+    }
+}
+
+int main() {
+    singleThread();
+    fullKeepsTheValue();
+    manyThreads();
+    return Test::finish();
+}
@@ -0,0 +1,76 @@
+#include "spscring.h"
+
+#include <thread>
+#include <vector>
+#include <memory>
+
+#include "check.h"
+
+namespace {
+    void singleThread() {
+        SPSCRing<int> ring(3);
+        CHECK(!ring.tryPop().has_value());
+        for (int i = 0; i < 4; ++i)         //rounded up to 4
+            CHECK(ring.tryPush(int(i)));
+
+        CHECK(!ring.tryPush(4));
+        for (int i = 0; i < 4; ++i)
+            CHECK(ring.tryPop() == i);
+
+        CHECK(!ring.tryPop().has_value());
+    }
+
+    void fullKeepsTheValue() {
+        SPSCRing<std::unique_ptr<int>> ring(2);
+        CHECK(ring.tryPush(std::make_unique<int>(1)));
+        CHECK(ring.tryPush(std::make_unique<int>(2)));
+        std::unique_ptr<int> third = std::make_unique<int>(3);
+        CHECK(!ring.tryPush(std::move(third)));
+        CHECK(third && *third == 3);
+    }
+
+    void inOrder() {        //the producer and the consumer both park often with two cells
+        constexpr int count = 200000;
+        SPSCRing<std::vector<int>> ring(2);
+        bool ordered = true;
+        int received = 0;
+        std::thread consumer([&] () {
+            while (std::optional<std::vector<int>> block = ring.pop()) {
+                if (block->size() != 2 || (*block)[0] != received || (*block)[1] != -received)
+                    ordered = false;
+
+                ++received;
+            }
+        });
+        for (int i = 0; i < count; ++i)
+            CHECK(ring.push({i, -i}));
+
+        ring.close();
+        consumer.join();
+        CHECK(ordered);
+        CHECK(received == count);       //closing lets the consumer drain what is left
+    }
+
+    void consumerCloses() {     //a failed stage closes its ring, the one that feeds it stops waiting
+        SPSCRing<int> ring(2);
+        std::thread consumer([&ring] () {
+            ring.pop();
+            ring.close();
+        });
+        int pushed = 0;
+        while (ring.push(int(pushed)))
+            ++pushed;
+
+        consumer.join();
+        CHECK(pushed >= 1);
+        CHECK(!ring.tryPush(0));
+    }
+}
+
+int main() {
+    singleThread();
+    fullKeepsTheValue();
+    inOrder();
+    consumerCloses();
+    return Test::finish();
+}